@@ -33,6 +33,9 @@ class EsappConan(ConanFile):
         'wrapper/CMakeLists.txt',
         'wrapper/python/CMakeLists.txt',
         'wrapper/python/esapp.cpp',
+        'tools/CMakeLists.txt',
+        'tools/*.cpp',
+        'tools/*.hpp',
     )
 
     _available_wrappers = set([
@@ -0,0 +1,60 @@
+/************************************************
+ *  binary_io.hpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#ifndef ESAPP_INTERNAL_BINARY_IO_HPP_
+#define ESAPP_INTERNAL_BINARY_IO_HPP_
+
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace esapp {
+
+namespace internal {
+
+/************************************************
+ * Declaration: class invalid_model_data
+ ************************************************/
+
+class invalid_model_data : public std::runtime_error {
+ public:  // Public Method(s)
+    using std::runtime_error::runtime_error;
+};  // class invalid_model_data
+
+/************************************************
+ * Declaration: function write_binary<T>
+ ************************************************/
+
+template <typename T>
+void write_binary(std::ostream &os, T const &value) {  // NOLINT(runtime/references)
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    os.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+/************************************************
+ * Declaration: function read_binary<T>
+ ************************************************/
+
+template <typename T>
+T read_binary(std::istream &is) {  // NOLINT(runtime/references)
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+    T value;
+    if (!is.read(reinterpret_cast<char *>(&value), sizeof(T))) {
+        throw invalid_model_data("Unexpected end of model data");
+    }
+
+    return value;
+}
+
+}  // namespace internal
+
+}  // namespace esapp
+
+#endif  // ESAPP_INTERNAL_BINARY_IO_HPP_
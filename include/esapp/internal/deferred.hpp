@@ -0,0 +1,150 @@
+/************************************************
+ *  deferred.hpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#ifndef ESAPP_INTERNAL_DEFERRED_HPP_
+#define ESAPP_INTERNAL_DEFERRED_HPP_
+
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace esapp {
+
+namespace internal {
+
+/************************************************
+ * Declaration: class deferred<T>
+ ************************************************/
+
+// storage for an object that is constructed after its owner, e.g. one that
+// needs an allocator which is not default constructible
+template <typename T>
+class deferred {
+ public:  // Public Method(s)
+    deferred();
+    deferred(deferred const &other);
+    deferred(deferred &&other);
+    ~deferred();
+
+    deferred &operator=(deferred const &other);
+    deferred &operator=(deferred &&other);
+
+    template <typename... Args>
+    T &emplace(Args &&... args);
+    void reset();
+
+    explicit operator bool() const;
+    T &operator*();
+    T const &operator*() const;
+    T *operator->();
+    T const *operator->() const;
+
+ private:  // Private Property(ies)
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+    bool has_value_;
+};  // class deferred<T>
+
+/************************************************
+ * Implementation: class deferred<T>
+ ************************************************/
+
+template <typename T>
+inline deferred<T>::deferred()
+    : has_value_(false) {
+    // do nothing
+}
+
+template <typename T>
+inline deferred<T>::deferred(deferred const &other)
+    : has_value_(false) {
+    if (other) { emplace(*other); }
+}
+
+template <typename T>
+inline deferred<T>::deferred(deferred &&other)
+    : has_value_(false) {
+    if (other) { emplace(std::move(*other)); }
+}
+
+template <typename T>
+inline deferred<T>::~deferred() {
+    reset();
+}
+
+template <typename T>
+deferred<T> &deferred<T>::operator=(deferred const &other) {
+    // the value is reconstructed rather than assigned, since allocators
+    // (and hence their containers) are not necessarily assignable
+    if (this != &other) {
+        reset();
+        if (other) { emplace(*other); }
+    }
+
+    return *this;
+}
+
+template <typename T>
+deferred<T> &deferred<T>::operator=(deferred &&other) {
+    if (this != &other) {
+        reset();
+        if (other) { emplace(std::move(*other)); }
+    }
+
+    return *this;
+}
+
+template <typename T>
+template <typename... Args>
+T &deferred<T>::emplace(Args &&... args) {
+    reset();
+    ::new (static_cast<void *>(&storage_)) T(std::forward<Args>(args)...);
+    has_value_ = true;
+    return **this;
+}
+
+template <typename T>
+inline void deferred<T>::reset() {
+    if (has_value_) {
+        (**this).~T();
+        has_value_ = false;
+    }
+}
+
+template <typename T>
+inline deferred<T>::operator bool() const {
+    return has_value_;
+}
+
+template <typename T>
+inline T &deferred<T>::operator*() {
+    assert(has_value_);
+    return *reinterpret_cast<T *>(&storage_);
+}
+
+template <typename T>
+inline T const &deferred<T>::operator*() const {
+    assert(has_value_);
+    return *reinterpret_cast<T const *>(&storage_);
+}
+
+template <typename T>
+inline T *deferred<T>::operator->() {
+    return &**this;
+}
+
+template <typename T>
+inline T const *deferred<T>::operator->() const {
+    return &**this;
+}
+
+}  // namespace internal
+
+}  // namespace esapp
+
+#endif  // ESAPP_INTERNAL_DEFERRED_HPP_
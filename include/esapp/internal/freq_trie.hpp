@@ -9,16 +9,23 @@
 #ifndef ESAPP_INTERNAL_FREQ_TRIE_HPP_
 #define ESAPP_INTERNAL_FREQ_TRIE_HPP_
 
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <unordered_map>
+#include <utility>
+
+#include "binary_io.hpp"
 
 namespace esapp {
 
 /************************************************
- * Declaration: class freq_trie<T>
+ * Declaration: class freq_trie<T, A>
  ************************************************/
 
-template <typename T>
+template <typename T, typename Allocator = std::allocator<T>>
 class freq_trie {
  public:  // Public Type(s)
     struct node;
@@ -26,16 +33,24 @@ class freq_trie {
     using const_raw_node_ptr = node const *;
     using term_type = T;
     using size_type = std::size_t;
+    using allocator_type = Allocator;
 
  public:  // Public Method(s)
-    freq_trie();
+    explicit freq_trie(allocator_type const &alloc = allocator_type());
+
+    allocator_type get_allocator() const;
 
     raw_node_ptr get_root();
     const_raw_node_ptr get_root() const;
 
+    template <typename Iterator>
+    raw_node_ptr find(Iterator const &begin, Iterator const &end);
     template <typename Iterator>
     const_raw_node_ptr find(Iterator const &begin, Iterator const &end) const;
 
+    template <typename Function>
+    void for_each(Function f);
+
     template <typename Iterator>
     void increase(Iterator const &begin, Iterator const &end);
 
@@ -44,53 +59,105 @@ class freq_trie {
 
     void clear();
 
+    void save(std::ostream &os) const;  // NOLINT(runtime/references)
+    void load(std::istream &is);  // NOLINT(runtime/references)
+
  private:  // Private Type(s)
-    using node_ptr = std::unique_ptr<node>;
-    using node_collection = std::unordered_map<term_type, node_ptr>;
+    using alloc_traits = std::allocator_traits<Allocator>;
+    using node_allocator = typename alloc_traits::template rebind_alloc<node>;
+    using node_alloc_traits = std::allocator_traits<node_allocator>;
+    class node_deleter;
+    using node_ptr = std::unique_ptr<node, node_deleter>;
+    using node_collection = std::unordered_map<
+        term_type, node_ptr, std::hash<term_type>, std::equal_to<term_type>,
+        typename alloc_traits::template rebind_alloc<std::pair<term_type const, node_ptr>>
+    >;
+
+ private:  // Private Static Method(s)
+    static node_ptr make_node(node_allocator alloc);
 
  private:  // Private Property(ies)
     node_ptr root_;
-};  // class freq_trie<T>
+};  // class freq_trie<T, A>
+
+/************************************************
+ * Declaration: class freq_trie<T, A>::node_deleter
+ ************************************************/
+
+template <typename T, typename A>
+class freq_trie<T, A>::node_deleter {
+ public:  // Public Method(s)
+    explicit node_deleter(node_allocator const &alloc);
+    void operator()(node *p);
+
+    node_allocator get_allocator() const;
+
+ private:  // Private Property(ies)
+    node_allocator alloc_;
+};  // class freq_trie<T, A>::node_deleter
 
 /************************************************
- * Declaration: struct freq_trie<T>::node
+ * Declaration: struct freq_trie<T, A>::node
  ************************************************/
 
-template <typename T>
-struct freq_trie<T>::node {
-    node();
+template <typename T, typename A>
+struct freq_trie<T, A>::node {
+    explicit node(node_allocator const &alloc);
 
     const_raw_node_ptr get(term_type key) const;
     raw_node_ptr get(term_type key, bool create = false);
     void clear();
+    template <typename Function>
+    void for_each(Function &f);  // NOLINT(runtime/references)
+    void save(std::ostream &os) const;  // NOLINT(runtime/references)
+    void load(std::istream &is);  // NOLINT(runtime/references)
 
     node_collection children;
     size_type f, avl, avr;
-};  // struct freq_trie<T>::node
+    size_type word_id;
+};  // struct freq_trie<T, A>::node
 
 /************************************************
- * Implementation: class freq_trie<T>
+ * Implementation: class freq_trie<T, A>
  ************************************************/
 
-template <typename T>
-inline freq_trie<T>::freq_trie()
-    : root_(new node()) {
+template <typename T, typename A>
+inline freq_trie<T, A>::freq_trie(allocator_type const &alloc)
+    : root_(make_node(node_allocator(alloc))) {
     // do nothing
 }
 
-template <typename T>
-inline typename freq_trie<T>::raw_node_ptr freq_trie<T>::get_root() {
+template <typename T, typename A>
+inline typename freq_trie<T, A>::allocator_type freq_trie<T, A>::get_allocator() const {
+    return allocator_type(root_.get_deleter().get_allocator());
+}
+
+template <typename T, typename A>
+inline typename freq_trie<T, A>::raw_node_ptr freq_trie<T, A>::get_root() {
     return root_.get();
 }
 
-template <typename T>
-inline typename freq_trie<T>::const_raw_node_ptr freq_trie<T>::get_root() const {
+template <typename T, typename A>
+inline typename freq_trie<T, A>::const_raw_node_ptr freq_trie<T, A>::get_root() const {
     return root_.get();
 }
 
-template <typename T>
+template <typename T, typename A>
+template <typename Iterator>
+typename freq_trie<T, A>::raw_node_ptr freq_trie<T, A>::find(Iterator const &begin,
+                                                             Iterator const &end) {
+    auto node = root_.get();
+    for (auto it = begin; it != end; ++it) {
+        node = node->get(*it);
+        if (!node) { return nullptr; }
+    }
+
+    return node;
+}
+
+template <typename T, typename A>
 template <typename Iterator>
-typename freq_trie<T>::const_raw_node_ptr freq_trie<T>::find(Iterator const &begin,
+typename freq_trie<T, A>::const_raw_node_ptr freq_trie<T, A>::find(Iterator const &begin,
                                               Iterator const &end) const {
     auto node = root_.get();
     for (auto it = begin; it != end; ++it) {
@@ -101,9 +168,9 @@ typename freq_trie<T>::const_raw_node_ptr freq_trie<T>::find(Iterator const &beg
     return node;
 }
 
-template <typename T>
+template <typename T, typename A>
 template <typename Iterator>
-void freq_trie<T>::increase(Iterator const &begin, Iterator const &end) {
+void freq_trie<T, A>::increase(Iterator const &begin, Iterator const &end) {
     for (auto it_begin = begin; it_begin != end; ++it_begin) {
         auto node = root_.get();
         for (auto it = it_begin; it != end; ++it) {
@@ -117,9 +184,9 @@ void freq_trie<T>::increase(Iterator const &begin, Iterator const &end) {
     }
 }
 
-template <typename T>
+template <typename T, typename A>
 template <typename Iterator>
-void freq_trie<T>::decrease(Iterator const &begin, Iterator const &end) {
+void freq_trie<T, A>::decrease(Iterator const &begin, Iterator const &end) {
     for (auto it_begin = begin; it_begin != end; ++it_begin) {
         auto node = root_.get();
         for (auto it = it_begin; it != end; ++it) {
@@ -133,29 +200,83 @@ void freq_trie<T>::decrease(Iterator const &begin, Iterator const &end) {
     }
 }
 
-template <typename T>
-inline void freq_trie<T>::clear() {
+template <typename T, typename A>
+inline void freq_trie<T, A>::clear() {
     root_->clear();
 }
 
+template <typename T, typename A>
+template <typename Function>
+inline void freq_trie<T, A>::for_each(Function f) {
+    root_->for_each(f);
+}
+
+template <typename T, typename A>
+inline void freq_trie<T, A>::save(std::ostream &os) const {  // NOLINT(runtime/references)
+    root_->save(os);
+}
+
+template <typename T, typename A>
+inline void freq_trie<T, A>::load(std::istream &is) {  // NOLINT(runtime/references)
+    root_->clear();
+    root_->load(is);
+}
+
+template <typename T, typename A>
+typename freq_trie<T, A>::node_ptr freq_trie<T, A>::make_node(node_allocator alloc) {
+    auto p = node_alloc_traits::allocate(alloc, 1);
+    try {
+        node_alloc_traits::construct(alloc, p, alloc);
+    } catch (...) {
+        node_alloc_traits::deallocate(alloc, p, 1);
+        throw;
+    }
+
+    return node_ptr(p, node_deleter(alloc));
+}
+
 /************************************************
- * Implementation: struct freq_trie<T>::node
+ * Implementation: class freq_trie<T, A>::node_deleter
  ************************************************/
 
-template <typename T>
-inline freq_trie<T>::node::node()
-    : f(1), avl(1), avr(1) {
+template <typename T, typename A>
+inline freq_trie<T, A>::node_deleter::node_deleter(node_allocator const &alloc)
+    : alloc_(alloc) {
     // do nothing
 }
 
-template <typename T>
-inline typename freq_trie<T>::const_raw_node_ptr freq_trie<T>::node::get(term_type key) const {
+template <typename T, typename A>
+inline void freq_trie<T, A>::node_deleter::operator()(node *p) {
+    node_alloc_traits::destroy(alloc_, p);
+    node_alloc_traits::deallocate(alloc_, p, 1);
+}
+
+template <typename T, typename A>
+inline typename freq_trie<T, A>::node_allocator
+freq_trie<T, A>::node_deleter::get_allocator() const {
+    return alloc_;
+}
+
+/************************************************
+ * Implementation: struct freq_trie<T, A>::node
+ ************************************************/
+
+template <typename T, typename A>
+inline freq_trie<T, A>::node::node(node_allocator const &alloc)
+    : children(alloc), f(1), avl(1), avr(1), word_id(0) {
+    // do nothing
+}
+
+template <typename T, typename A>
+inline typename freq_trie<T, A>::const_raw_node_ptr
+freq_trie<T, A>::node::get(term_type key) const {
     auto it = children.find(key);
     return (it != children.end()) ? it->second.get() : nullptr;
 }
 
-template <typename T>
-inline typename freq_trie<T>::raw_node_ptr freq_trie<T>::node::get(term_type key, bool create) {
+template <typename T, typename A>
+inline typename freq_trie<T, A>::raw_node_ptr
+freq_trie<T, A>::node::get(term_type key, bool create) {
     auto it = children.find(key);
     if (it != children.end()) {
         return it->second.get();
@@ -163,14 +284,51 @@ inline typename freq_trie<T>::raw_node_ptr freq_trie<T>::node::get(term_type key
         return nullptr;
     }
 
-    children.emplace(key, node_ptr(new node()));
-    return children[key].get();
+    auto result = children.emplace(key, make_node(children.get_allocator()));
+    return result.first->second.get();
 }
 
-template <typename T>
-inline void freq_trie<T>::node::clear() {
+template <typename T, typename A>
+inline void freq_trie<T, A>::node::clear() {
     children.clear();
     f = avl = avr = 0;
+    word_id = 0;
+}
+
+template <typename T, typename A>
+template <typename Function>
+void freq_trie<T, A>::node::for_each(Function &f) {  // NOLINT(runtime/references)
+    f(*this);
+    for (auto &p : children) {
+        p.second->for_each(f);
+    }
+}
+
+template <typename T, typename A>  // NOLINTNEXTLINE(runtime/references)
+void freq_trie<T, A>::node::save(std::ostream &os) const {
+    internal::write_binary<std::uint64_t>(os, f);
+    internal::write_binary<std::uint64_t>(os, avl);
+    internal::write_binary<std::uint64_t>(os, avr);
+    internal::write_binary<std::uint64_t>(os, word_id);
+    internal::write_binary<std::uint64_t>(os, children.size());
+    for (auto const &p : children) {
+        internal::write_binary<term_type>(os, p.first);
+        p.second->save(os);
+    }
+}
+
+template <typename T, typename A>  // NOLINTNEXTLINE(runtime/references)
+void freq_trie<T, A>::node::load(std::istream &is) {
+    f = internal::read_binary<std::uint64_t>(is);
+    avl = internal::read_binary<std::uint64_t>(is);
+    avr = internal::read_binary<std::uint64_t>(is);
+    word_id = internal::read_binary<std::uint64_t>(is);
+
+    auto n = internal::read_binary<std::uint64_t>(is);
+    for (decltype(n) i = 0; i < n; i++) {
+        auto key = internal::read_binary<term_type>(is);
+        get(key, true)->load(is);
+    }
 }
 
 }  // namespace esapp
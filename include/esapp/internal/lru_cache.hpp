@@ -0,0 +1,236 @@
+/************************************************
+ *  lru_cache.hpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#ifndef ESAPP_INTERNAL_LRU_CACHE_HPP_
+#define ESAPP_INTERNAL_LRU_CACHE_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace esapp {
+
+namespace internal {
+
+/************************************************
+ * Declaration: struct cache_stats
+ ************************************************/
+
+struct cache_stats {
+    std::size_t hits;
+    std::size_t misses;
+};  // struct cache_stats
+
+/************************************************
+ * Declaration: struct sequence_hash<S>
+ ************************************************/
+
+template <typename Sequence>
+struct sequence_hash {
+    std::size_t operator()(Sequence const &s) const;
+};  // struct sequence_hash<S>
+
+/************************************************
+ * Declaration: class lru_cache<K, V, H>
+ ************************************************/
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class lru_cache {
+ public:  // Public Type(s)
+    using key_type = Key;
+    using value_type = Value;
+    using size_type = std::size_t;
+
+ public:  // Public Method(s)
+    explicit lru_cache(size_type capacity = 0, size_type num_shards = 16);
+    lru_cache(lru_cache const &other);
+    lru_cache &operator=(lru_cache const &other);
+
+    size_type capacity() const;
+    size_type num_shards() const;
+    cache_stats stats() const;
+
+    bool get(key_type const &key, value_type &value);  // NOLINT(runtime/references)
+    void put(key_type const &key, value_type const &value);
+    void clear();
+
+ private:  // Private Type(s)
+    struct shard;
+
+ private:  // Private Method(s)
+    shard &shard_of(key_type const &key) const;
+
+ private:  // Private Property(ies)
+    size_type capacity_;
+    size_type num_shards_;
+    std::unique_ptr<shard[]> shards_;
+};  // class lru_cache<K, V, H>
+
+/************************************************
+ * Declaration: struct lru_cache<K, V, H>::shard
+ ************************************************/
+
+template <typename K, typename V, typename H>
+struct lru_cache<K, V, H>::shard {
+    using entry_list = std::list<std::pair<K, V>>;
+
+    std::mutex mutex;
+    size_type capacity;
+    size_type hits, misses;  // guarded by the mutex, like the entries
+    entry_list entries;  // most recently used first
+    std::unordered_map<K, typename entry_list::iterator, H> positions;
+
+    // keep the mutex and counters of adjacent shards on different cache lines
+    char padding[64];
+};  // struct lru_cache<K, V, H>::shard
+
+/************************************************
+ * Implementation: struct sequence_hash<S>
+ ************************************************/
+
+template <typename S>
+std::size_t sequence_hash<S>::operator()(S const &s) const {
+    // FNV-1a over the elements of the sequence
+    std::size_t h = 14695981039346656037ULL;
+    for (auto const &c : s) {
+        h ^= static_cast<std::size_t>(c);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/************************************************
+ * Implementation: class lru_cache<K, V, H>
+ ************************************************/
+
+template <typename K, typename V, typename H>
+lru_cache<K, V, H>::lru_cache(size_type capacity, size_type num_shards)
+    : capacity_(capacity),
+      num_shards_(std::max<size_type>(std::min(num_shards, capacity), 1)),
+      shards_(capacity > 0 ? new shard[num_shards_] : nullptr) {
+    if (!shards_) { return; }
+
+    // spread the capacity exactly over the shards, of which there are never
+    // more than entries
+    for (decltype(num_shards_) i = 0; i < num_shards_; i++) {
+        shards_[i].capacity = capacity_ / num_shards_ + (i < capacity_ % num_shards_ ? 1 : 0);
+        shards_[i].hits = shards_[i].misses = 0;
+    }
+}
+
+template <typename K, typename V, typename H>
+inline lru_cache<K, V, H>::lru_cache(lru_cache const &other)
+    : lru_cache(other.capacity_, other.num_shards_) {
+    // do nothing
+}
+
+template <typename K, typename V, typename H>
+lru_cache<K, V, H> &lru_cache<K, V, H>::operator=(lru_cache const &other) {
+    if (this != &other) {
+        lru_cache tmp(other);
+        capacity_ = tmp.capacity_;
+        num_shards_ = tmp.num_shards_;
+        shards_ = std::move(tmp.shards_);
+    }
+
+    return *this;
+}
+
+template <typename K, typename V, typename H>
+inline typename lru_cache<K, V, H>::size_type lru_cache<K, V, H>::capacity() const {
+    return capacity_;
+}
+
+template <typename K, typename V, typename H>
+inline typename lru_cache<K, V, H>::size_type lru_cache<K, V, H>::num_shards() const {
+    return num_shards_;
+}
+
+template <typename K, typename V, typename H>
+cache_stats lru_cache<K, V, H>::stats() const {
+    cache_stats result{0, 0};
+    if (!shards_) { return result; }
+
+    for (decltype(num_shards_) i = 0; i < num_shards_; i++) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        result.hits += shards_[i].hits;
+        result.misses += shards_[i].misses;
+    }
+
+    return result;
+}
+
+template <typename K, typename V, typename H>  // NOLINTNEXTLINE(runtime/references)
+bool lru_cache<K, V, H>::get(key_type const &key, value_type &value) {
+    if (!shards_) { return false; }
+
+    auto &s = shard_of(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.positions.find(key);
+    if (it == s.positions.end()) {
+        s.misses++;
+        return false;
+    }
+
+    s.entries.splice(s.entries.begin(), s.entries, it->second);
+    value = it->second->second;
+    s.hits++;
+    return true;
+}
+
+template <typename K, typename V, typename H>
+void lru_cache<K, V, H>::put(key_type const &key, value_type const &value) {
+    if (!shards_) { return; }
+
+    auto &s = shard_of(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.positions.find(key);
+    if (it != s.positions.end()) {
+        it->second->second = value;
+        s.entries.splice(s.entries.begin(), s.entries, it->second);
+        return;
+    }
+
+    if (s.entries.size() >= s.capacity) {
+        s.positions.erase(s.entries.back().first);
+        s.entries.pop_back();
+    }
+
+    s.entries.emplace_front(key, value);
+    s.positions.emplace(key, s.entries.begin());
+}
+
+template <typename K, typename V, typename H>
+void lru_cache<K, V, H>::clear() {
+    if (!shards_) { return; }
+
+    for (decltype(num_shards_) i = 0; i < num_shards_; i++) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].positions.clear();
+        shards_[i].entries.clear();
+    }
+}
+
+template <typename K, typename V, typename H>
+inline typename lru_cache<K, V, H>::shard &lru_cache<K, V, H>::shard_of(
+        key_type const &key) const {
+    // use the high bits, which are not the ones selecting buckets inside a shard
+    auto h = H()(key);
+    return shards_[(h >> (sizeof(h) * 4)) % num_shards_];
+}
+
+}  // namespace internal
+
+}  // namespace esapp
+
+#endif  // ESAPP_INTERNAL_LRU_CACHE_HPP_
@@ -8,10 +8,22 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdint>
+#include <istream>
 #include <limits>
+#include <memory>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "binary_io.hpp"
+#include "deferred.hpp"
 #include "freq_trie.hpp"
+#include "word_automaton.hpp"
 
 #ifndef ESAPP_INTERNAL_WITH_SEGMENTS_HPP_
 #define ESAPP_INTERNAL_WITH_SEGMENTS_HPP_
@@ -21,89 +33,260 @@ namespace esapp {
 namespace internal {
 
 /************************************************
- * Declaration: struct with_segments<N>
+ * Declaration: struct with_segments<N, A>
  ************************************************/
 
-template <std::size_t N = 30>
+template <std::size_t N = 30, typename Allocator = std::allocator<std::size_t>>
 struct with_segments {
     template <typename TextIndex, typename Trait>
     class policy;
-};  // class with_segments<N>
+};  // class with_segments<N, A>
 
 /************************************************
- * Declaration: class with_segments<N>::policy<LCP, T>
+ * Declaration: class with_segments<N, A>::policy<LCP, T>
  ************************************************/
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename Trait>
-class with_segments<N>::policy {
+class with_segments<N, A>::policy {
  public:  // Public Type(s)
     using host_type = LCP;
     using size_type = typename Trait::size_type;
     using term_type = std::uint16_t;
-    using seg_pos_vec_type = std::vector<size_type>;
+    using allocator_type = A;
+    using automaton_type = word_automaton<term_type>;
+    using seg_pos_vec_type = std::vector<
+        size_type,
+        typename std::allocator_traits<A>::template rebind_alloc<size_type>
+    >;
 
  public:  // Public Method(s)
     policy();
+    void reset_allocator(allocator_type const &alloc);
+    allocator_type get_allocator() const;
+    void set_max_length(size_type max_len);
+    size_type get_max_length() const;
+    size_type get_num_sequences() const;
+    // rebuilds the index from the retained sequences: O(retained) per call
+    void evict(size_type num_seqs);
+
+    void warm_start(automaton_type const &words);
     void optimize(double lrv_exp, size_type num_iters);
+    template <typename Callback>
+    void optimize(double lrv_exp, size_type num_iters, size_type first_seq, Callback after_seq);
+    template <typename Schedule, typename RandomGenerator>
+    void optimize(double lrv_exp, size_type num_steps, size_type batch_size,
+                  Schedule schedule, RandomGenerator &gen);  // NOLINT(runtime/references)
 
     template <typename Sequence>
-    seg_pos_vec_type segment(Sequence const &s, double lrv_exp) const;
+    std::vector<size_type> segment(Sequence const &s, double lrv_exp) const;
+    template <typename Sequence, typename OutputIterator>
+    OutputIterator segment_ids(Sequence const &s, double lrv_exp, OutputIterator d_it) const;
+
+    size_type build_vocabulary();
+    size_type get_vocabulary_size() const;
+    template <typename Function>
+    void for_each_word(Function f) const;
+
+    void save(std::ostream &os) const;  // NOLINT(runtime/references)
+    void load(std::istream &is);  // NOLINT(runtime/references)
+    void save_state(std::ostream &os) const;  // NOLINT(runtime/references)
+    void load_state(std::istream &is);  // NOLINT(runtime/references)
 
  private:  // Private Type(s)
     using event = typename Trait::event;
     using seq_type = std::vector<term_type>;
+    using trie_type = freq_trie<
+        term_type,
+        typename std::allocator_traits<A>::template rebind_alloc<term_type>
+    >;
+    using node_vec_type = std::vector<typename trie_type::const_raw_node_ptr>;
 
  protected:  // Protected Method(s)
     template <typename Sequence>
     void update(typename event::template after_inserting_lcp<Sequence> const &info);
 
  private:  // Private Method(s)
+    void init_allocator(std::true_type);
+    void init_allocator(std::false_type);
     template <typename Sequence>
     void update_counts(Sequence const &s, size_type n, size_type lcp_lf);
 
     // NOLINTNEXTLINE(runtime/references)
     void recover_sequence(size_type &i, seq_type &s) const;
-    std::vector<size_type> segment_sequence(
-        seq_type const &s,
-        seg_pos_vec_type &seg_pos_vec,  // NOLINT(runtime/references)
-        double lrv_exp) const;
+    void locate_sequences();
+    void optimize_sequence(seq_type const &s,
+                           seg_pos_vec_type &seg_pos_vec,  // NOLINT(runtime/references)
+                           double lrv_exp);
+    template <typename SegPosVec>
+    std::vector<size_type> segment_sequence(seq_type const &s, SegPosVec const &seg_pos_vec,
+                                            double lrv_exp,
+                                            node_vec_type *nodes = nullptr) const;
+    void load_counts(std::istream &is);  // NOLINT(runtime/references)
     void increase_counts(seq_type const &s, seg_pos_vec_type const &seg_pos_vec);
     void decrease_counts(seq_type const &s, seg_pos_vec_type const &seg_pos_vec);
-    void generate_seg_pos_vec(seg_pos_vec_type &seg_pos_vec,  // NOLINT(runtime/references)
+    template <typename SegPosVec>
+    void generate_seg_pos_vec(SegPosVec &seg_pos_vec,  // NOLINT(runtime/references)
                               std::vector<size_type> const &fs) const;
 
  private:  // Private Property(ies)
+    deferred<allocator_type> alloc_;
+    size_type max_len_;
+    size_type vocab_size_;
     size_type lcp_;
-    freq_trie<term_type> trie_;
+    deferred<trie_type> trie_;
     std::array<size_type, N> sum_f_;
     std::array<size_type, N> sum_av_;
     std::array<size_type, N> num_str_;
     std::vector<seg_pos_vec_type> seg_pos_vecs_;
-};  // class with_segments<N>::policy<LCP, T>
+    std::vector<size_type> seq_rows_;
+};  // class with_segments<N, A>::policy<LCP, T>
 
 /************************************************
- * Implementation: class with_segments<N>::policy<LCP, T>
+ * Implementation: class with_segments<N, A>::policy<LCP, T>
  ************************************************/
 
-template <std::size_t N>
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+with_segments<N, A>::policy<LCP, T>::policy()
+    : alloc_(), max_len_(N), vocab_size_(1), lcp_(0), trie_(), sum_f_(), sum_av_(),
+      num_str_(), seg_pos_vecs_(), seq_rows_() {
+    // the trie is only built once an allocator is given, unless there is a
+    // default one; a stateful allocator need not be default constructible
+    init_allocator(std::is_default_constructible<allocator_type>());
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+void with_segments<N, A>::policy<LCP, T>::reset_allocator(allocator_type const &alloc) {
+    // drop all the segmentation state, so that nothing allocated by the
+    // previous allocator outlives it
+    seg_pos_vecs_.clear();
+    seq_rows_.clear();
+    trie_.emplace(alloc);
+    alloc_.emplace(alloc);
+
+    vocab_size_ = 1;
+    lcp_ = 0;
+    sum_f_.fill(0);
+    sum_av_.fill(0);
+    num_str_.fill(0);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+inline void with_segments<N, A>::policy<LCP, T>::init_allocator(std::true_type) {
+    reset_allocator(allocator_type());
+}
+
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
-with_segments<N>::policy<LCP, T>::policy()
-    : lcp_(0), trie_(), sum_f_(), sum_av_(), num_str_(), seg_pos_vecs_() {
+inline void with_segments<N, A>::policy<LCP, T>::init_allocator(std::false_type) {
     // do nothing
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+inline typename with_segments<N, A>::template policy<LCP, T>::allocator_type
+with_segments<N, A>::policy<LCP, T>::get_allocator() const {
+    return *alloc_;
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+void with_segments<N, A>::policy<LCP, T>::set_max_length(size_type max_len) {
+    if (!seg_pos_vecs_.empty()) {
+        throw std::logic_error("Cannot change maximum word length of a fitted index");
+    } else if (max_len == 0 || max_len > N) {
+        throw std::out_of_range("Maximum word length out of range");
+    }
+
+    max_len_ = max_len;
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+inline typename with_segments<N, A>::template policy<LCP, T>::size_type
+with_segments<N, A>::policy<LCP, T>::get_max_length() const {
+    return max_len_;
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+inline typename with_segments<N, A>::template policy<LCP, T>::size_type
+with_segments<N, A>::policy<LCP, T>::get_num_sequences() const {
+    return seg_pos_vecs_.size();
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+void with_segments<N, A>::policy<LCP, T>::evict(size_type num_seqs) {
+    using ti_ptr_type = typename host_type::host_type *;
+
+    auto n = seg_pos_vecs_.size();
+    num_seqs = std::min(num_seqs, n);
+    if (num_seqs == 0) { return; }
+
+    // the index cannot remove sequences, and the counts of a substring
+    // depend on its neighbours in the suffix order, so the index is rebuilt
+    // from the retained sequences; they are first copied out as plain
+    // terms, so that the old index is released before the new one is built
+    seq_type terms;
+    std::vector<size_type> ends;
+    std::vector<seg_pos_vec_type> seg_pos_vecs;
+    ends.reserve(n - num_seqs);
+    seg_pos_vecs.reserve(n - num_seqs);
+
+    size_type i = 0;
+    seq_type s;
+    for (decltype(n) j = 0; j < n; j++) {
+        recover_sequence(i, s);
+        if (j < num_seqs) { continue; }
+
+        terms.insert(terms.end(), s.begin(), s.end());
+        ends.push_back(terms.size());
+        seg_pos_vecs.push_back(std::move(seg_pos_vecs_[j]));
+    }
+
+    assert(i == 0);
+
+    auto alloc = *alloc_;
+    auto max_len = max_len_;
+    auto ti = static_cast<ti_ptr_type>(this);
+    *ti = typename host_type::host_type();
+    reset_allocator(alloc);
+    set_max_length(max_len);
+
+    // every sequence has to be inserted before any segmentation is
+    // subtracted, since the trie nodes of a word may only be created by a
+    // later sequence
+    auto m = ends.size();
+    for (decltype(m) k = 0; k < m; k++) {
+        s.assign(terms.begin() + (k > 0 ? ends[k - 1] : 0), terms.begin() + ends[k]);
+        ti->insert(s);
+    }
+
+    for (decltype(m) k = 0; k < m; k++) {
+        s.assign(terms.begin() + (k > 0 ? ends[k - 1] : 0), terms.begin() + ends[k]);
+        seg_pos_vecs_[k] = std::move(seg_pos_vecs[k]);
+        if (!seg_pos_vecs_[k].empty()) {
+            decrease_counts(s, seg_pos_vecs_[k]);
+        }
+    }
+}
+
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
 template <typename Sequence>
-void with_segments<N>::policy<LCP, T>::update(
+void with_segments<N, A>::policy<LCP, T>::update(
         typename event::template after_inserting_lcp<Sequence> const &info) {
     if (info.num_inserted == 0) {
         assert(info.lcp == 0);
         assert(info.lcp_next == 0);
         lcp_ = 0;
 
-        seg_pos_vecs_.emplace_back();
+        seg_pos_vecs_.emplace_back(*alloc_);
+        seq_rows_.clear();
         return;
     }
 
@@ -118,51 +301,345 @@ void with_segments<N>::policy<LCP, T>::update(
     }
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
-void with_segments<N>::policy<LCP, T>::optimize(double lrv_exp, size_type num_iters) {
+void with_segments<N, A>::policy<LCP, T>::warm_start(automaton_type const &words) {
+    // without any word, every sequence would be split into single terms,
+    // which is a worse start than the current segmentation
+    if (words.empty()) { return; }
+
+    // replace the segmentation of every sequence by a forward maximal
+    // match against the given words; terms not starting any word are
+    // single-term words
     size_type i = 0;
     seq_type s;
 
     auto n = seg_pos_vecs_.size();
+    for (decltype(n) j = 0; j < n; j++) {
+        recover_sequence(i, s);
+
+        auto &seg_pos_vec = seg_pos_vecs_[j];
+        if (!seg_pos_vec.empty()) {
+            increase_counts(s, seg_pos_vec);
+        }
+
+        seg_pos_vec.clear();
+        for (size_type pos = 0, len = s.size(); pos < len; ) {
+            auto end = std::min(len, pos + max_len_);
+            pos += std::max<size_type>(words.match(s.begin() + pos, s.begin() + end), 1);
+            seg_pos_vec.push_back(pos);
+        }
+
+        decrease_counts(s, seg_pos_vec);
+    }
+
+    assert(i == 0);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+inline void with_segments<N, A>::policy<LCP, T>::optimize(double lrv_exp, size_type num_iters) {
+    optimize(lrv_exp, num_iters, 0, [](size_type, size_type) { /* do nothing */ });
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+template <typename Callback>
+void with_segments<N, A>::policy<LCP, T>::optimize(
+        double lrv_exp, size_type num_iters, size_type first_seq, Callback after_seq) {
+    auto n = seg_pos_vecs_.size();
+    if (first_seq >= n) {
+        first_seq = 0;
+    }
+
+    // the first pass may start in the middle, e.g. when resuming; after
+    // each sequence, the callback receives the number of completed passes
+    // and of sequences done in the current one
+    size_type i = 0;
+    if (first_seq > 0) {
+        locate_sequences();
+        i = seq_rows_[first_seq];
+    }
+
+    seq_type s;
     for (decltype(num_iters) count = 0; count < num_iters; count++) {
-        for (decltype(n) j = 0; j < n; j++) {
+        for (auto j = first_seq; j < n; j++) {
             recover_sequence(i, s);
-
-            auto fs = segment_sequence(s, seg_pos_vecs_[j], lrv_exp);
-            if (!seg_pos_vecs_[j].empty()) {
-                increase_counts(s, seg_pos_vecs_[j]);
+            optimize_sequence(s, seg_pos_vecs_[j], lrv_exp);
+            if (j + 1 < n) {
+                after_seq(count, j + 1);
             }
-
-            generate_seg_pos_vec(seg_pos_vecs_[j], fs);
-            decrease_counts(s, seg_pos_vecs_[j]);
         }
 
         assert(i == 0);
+        first_seq = 0;
+        after_seq(count + 1, 0);
+    }
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+template <typename Schedule, typename RandomGenerator>
+void with_segments<N, A>::policy<LCP, T>::optimize(
+        double lrv_exp, size_type num_steps, size_type batch_size,
+        Schedule schedule, RandomGenerator &gen) {  // NOLINT(runtime/references)
+    auto n = seg_pos_vecs_.size();
+    if (n == 0) { return; }
+
+    locate_sequences();
+
+    // sequences are drawn without replacement; the order is reshuffled
+    // each time every sequence has been visited once
+    std::vector<size_type> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), gen);
+
+    decltype(n) k = 0;
+    seq_type s;
+    for (decltype(num_steps) step = 0; step < num_steps; step++) {
+        auto m = std::min<size_type>(schedule(step, batch_size), n);
+        for (decltype(m) count = 0; count < m; count++) {
+            if (k == n) {
+                std::shuffle(order.begin(), order.end(), gen);
+                k = 0;
+            }
+
+            auto j = order[k++];
+            auto i = seq_rows_[j];
+            recover_sequence(i, s);
+            optimize_sequence(s, seg_pos_vecs_[j], lrv_exp);
+        }
     }
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
 template <typename Sequence>
-typename with_segments<N>::template policy<LCP, T>::seg_pos_vec_type
-with_segments<N>::policy<LCP, T>::segment(Sequence const &s, double lrv_exp) const {
-    decltype(segment(s, lrv_exp)) seg_pos_vec;
+std::vector<typename with_segments<N, A>::template policy<LCP, T>::size_type>
+with_segments<N, A>::policy<LCP, T>::segment(Sequence const &s, double lrv_exp) const {
+    // queries use the global heap, so that they neither grow the model's
+    // storage nor touch its allocator from concurrent readers
+    std::vector<size_type> seg_pos_vec;
     auto fs = segment_sequence(s, seg_pos_vec, lrv_exp);
     generate_seg_pos_vec(seg_pos_vec, fs);
     return seg_pos_vec;
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+template <typename Sequence, typename OutputIterator>
+OutputIterator with_segments<N, A>::policy<LCP, T>::segment_ids(
+        Sequence const &s, double lrv_exp, OutputIterator d_it) const {
+    std::vector<size_type> seg_pos_vec;
+    node_vec_type nodes(s.size(), nullptr);
+    auto fs = segment_sequence(s, seg_pos_vec, lrv_exp, &nodes);
+    generate_seg_pos_vec(seg_pos_vec, fs);
+    for (auto pos : seg_pos_vec) {
+        auto node = nodes[pos - 1];
+        *d_it++ = node ? node->word_id : 0;
+    }
+
+    return d_it;
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+typename with_segments<N, A>::template policy<LCP, T>::size_type
+with_segments<N, A>::policy<LCP, T>::build_vocabulary() {
+    using node_type = typename trie_type::node;
+
+    // a loaded model has no sequences to rebuild the vocabulary from, so
+    // the ids it has been saved with are kept
+    if (seg_pos_vecs_.empty()) {
+        return vocab_size_;
+    }
+
+    trie_->for_each([](node_type &node) { node.word_id = 0; });
+
+    // assign ids in order of first occurrence to the trie nodes of words in
+    // the current segmentation; id 0 is left for unknown words
+    vocab_size_ = 1;
+    size_type i = 0;
+    seq_type s;
+
+    auto n = seg_pos_vecs_.size();
+    for (decltype(n) j = 0; j < n; j++) {
+        recover_sequence(i, s);
+
+        typename seg_pos_vec_type::value_type prev_pos = 0;
+        for (auto pos : seg_pos_vecs_[j]) {
+            auto node = trie_->find(s.begin() + prev_pos, s.begin() + pos);
+            if (node && node->word_id == 0) {
+                node->word_id = vocab_size_++;
+            }
+
+            prev_pos = pos;
+        }
+    }
+
+    return vocab_size_;
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+inline typename with_segments<N, A>::template policy<LCP, T>::size_type
+with_segments<N, A>::policy<LCP, T>::get_vocabulary_size() const {
+    return vocab_size_;
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+template <typename Function>
+void with_segments<N, A>::policy<LCP, T>::for_each_word(Function f) const {
+    using node_type = typename trie_type::node;
+
+    struct frame {
+        node_type const *node;
+        term_type c;
+        size_type depth;
+    };
+
+    // depth-first walk over the trie, calling f with the terms of every
+    // word in the vocabulary
+    seq_type word;
+    std::vector<frame> stack;
+    for (auto const &p : trie_->get_root()->children) {
+        stack.push_back(frame{p.second.get(), p.first, 0});
+    }
+
+    while (!stack.empty()) {
+        auto top = stack.back();
+        stack.pop_back();
+
+        word.resize(top.depth);
+        word.push_back(top.c);
+        if (top.node->word_id != 0) {
+            f(word);
+        }
+
+        for (auto const &p : top.node->children) {
+            stack.push_back(frame{p.second.get(), p.first, word.size()});
+        }
+    }
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>  // NOLINTNEXTLINE(runtime/references)
+void with_segments<N, A>::policy<LCP, T>::save(std::ostream &os) const {
+    internal::write_binary<std::uint64_t>(os, N);
+    internal::write_binary<std::uint64_t>(os, max_len_);
+    internal::write_binary<std::uint64_t>(os, vocab_size_);
+    for (decltype(N) i = 0; i < N; i++) {
+        internal::write_binary<std::uint64_t>(os, sum_f_[i]);
+        internal::write_binary<std::uint64_t>(os, sum_av_[i]);
+        internal::write_binary<std::uint64_t>(os, num_str_[i]);
+    }
+
+    trie_->save(os);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>  // NOLINTNEXTLINE(runtime/references)
+void with_segments<N, A>::policy<LCP, T>::load(std::istream &is) {
+    if (!seg_pos_vecs_.empty()) {
+        throw std::logic_error("Cannot load counts into a fitted index");
+    }
+
+    load_counts(is);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>  // NOLINTNEXTLINE(runtime/references)
+void with_segments<N, A>::policy<LCP, T>::save_state(std::ostream &os) const {
+    // each sequence is recovered and written together with its current
+    // segmentation, followed by the counts
+    size_type i = 0;
+    seq_type s;
+
+    auto n = seg_pos_vecs_.size();
+    internal::write_binary<std::uint64_t>(os, n);
+    for (decltype(n) j = 0; j < n; j++) {
+        recover_sequence(i, s);
+
+        internal::write_binary<std::uint64_t>(os, s.size());
+        for (auto c : s) {
+            internal::write_binary<term_type>(os, c);
+        }
+
+        internal::write_binary<std::uint64_t>(os, seg_pos_vecs_[j].size());
+        for (auto pos : seg_pos_vecs_[j]) {
+            internal::write_binary<std::uint64_t>(os, pos);
+        }
+    }
+
+    save(os);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>  // NOLINTNEXTLINE(runtime/references)
+void with_segments<N, A>::policy<LCP, T>::load_state(std::istream &is) {
+    using ti_ptr_type = typename host_type::host_type *;
+
+    if (!seg_pos_vecs_.empty()) {
+        throw std::logic_error("Cannot load state into a fitted index");
+    }
+
+    // re-inserting the sequences in their original order rebuilds the same
+    // index; the counts are then overwritten with the saved ones
+    seq_type s;
+    auto n = internal::read_binary<std::uint64_t>(is);
+    for (decltype(n) j = 0; j < n; j++) {
+        s.resize(internal::read_binary<std::uint64_t>(is));
+        for (auto &c : s) {
+            c = internal::read_binary<term_type>(is);
+        }
+
+        static_cast<ti_ptr_type>(this)->insert(s);
+
+        auto &seg_pos_vec = seg_pos_vecs_.back();
+        seg_pos_vec.resize(internal::read_binary<std::uint64_t>(is));
+        for (auto &pos : seg_pos_vec) {
+            pos = internal::read_binary<std::uint64_t>(is);
+        }
+    }
+
+    load_counts(is);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>  // NOLINTNEXTLINE(runtime/references)
+void with_segments<N, A>::policy<LCP, T>::load_counts(std::istream &is) {
+    if (internal::read_binary<std::uint64_t>(is) != N) {
+        throw invalid_model_data("Mismatched maximum word length");
+    }
+
+    auto max_len = internal::read_binary<std::uint64_t>(is);
+    if (max_len == 0 || max_len > N) {
+        throw invalid_model_data("Maximum word length out of range");
+    }
+
+    max_len_ = max_len;
+    vocab_size_ = internal::read_binary<std::uint64_t>(is);
+
+    for (decltype(N) i = 0; i < N; i++) {
+        sum_f_[i] = internal::read_binary<std::uint64_t>(is);
+        sum_av_[i] = internal::read_binary<std::uint64_t>(is);
+        num_str_[i] = internal::read_binary<std::uint64_t>(is);
+    }
+
+    trie_->load(is);
+}
+
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
 template <typename Sequence>
-void with_segments<N>::policy<LCP, T>::update_counts(
+void with_segments<N, A>::policy<LCP, T>::update_counts(
         Sequence const &s, size_type n, size_type lcp_lf) {
     assert(lcp_ <= n);
     if (lcp_ > 0) {
         auto it = rbegin(s) + n - 1;
-        auto node = trie_.get_root();
-        auto max_i = std::min(lcp_, N);
+        auto node = trie_->get_root();
+        auto max_i = std::min(lcp_, max_len_);
         for (decltype(max_i) i = 0; i < max_i; i++) {
             auto c = *it;
             node = node->get(c, true);
@@ -175,13 +652,13 @@ void with_segments<N>::policy<LCP, T>::update_counts(
             --it;
         }
 
-        if (lcp_ <= N) {
+        if (lcp_ <= max_len_) {
             node->avr++;
             sum_av_[max_i - 1]++;
         }
     }
 
-    auto max_i = std::min(n, N);
+    auto max_i = std::min(n, max_len_);
     for (auto i = lcp_; i < max_i; i++) {
         sum_f_[i]++;
         sum_av_[i]++;
@@ -189,9 +666,9 @@ void with_segments<N>::policy<LCP, T>::update_counts(
     }
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename T>  // NOLINTNEXTLINE(runtime/references)
-void with_segments<N>::policy<LCP, T>::recover_sequence(size_type &i, seq_type &s) const {
+void with_segments<N, A>::policy<LCP, T>::recover_sequence(size_type &i, seq_type &s) const {
     using ti_ptr_type = typename host_type::host_type const *;
 
     s.clear();
@@ -208,11 +685,55 @@ void with_segments<N>::policy<LCP, T>::recover_sequence(size_type &i, seq_type &
     std::reverse(s.begin(), s.end());
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+void with_segments<N, A>::policy<LCP, T>::locate_sequences() {
+    auto n = seg_pos_vecs_.size();
+    if (seq_rows_.size() == n) { return; }
+
+    // record the row preceding each sequence, so that any of them can be
+    // recovered without walking through all of the previous ones
+    size_type i = 0;
+    seq_type s;
+    seq_rows_.clear();
+    seq_rows_.reserve(n);
+    for (decltype(n) j = 0; j < n; j++) {
+        seq_rows_.push_back(i);
+        recover_sequence(i, s);
+    }
+
+    assert(i == 0);
+}
+
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
-std::vector<typename with_segments<N>::template policy<LCP, T>::size_type>
-with_segments<N>::policy<LCP, T>::segment_sequence(  // NOLINTNEXTLINE(runtime/references)
-        seq_type const &s, seg_pos_vec_type &seg_pos_vec, double lrv_exp) const {
+void with_segments<N, A>::policy<LCP, T>::optimize_sequence(  // NOLINTNEXTLINE(runtime/references)
+        seq_type const &s, seg_pos_vec_type &seg_pos_vec, double lrv_exp) {
+    auto fs = segment_sequence(s, seg_pos_vec, lrv_exp);
+    if (!seg_pos_vec.empty()) {
+        increase_counts(s, seg_pos_vec);
+    }
+
+    generate_seg_pos_vec(seg_pos_vec, fs);
+    decrease_counts(s, seg_pos_vec);
+}
+
+template <std::size_t N, typename A>
+template <typename LCP, typename T>
+template <typename SegPosVec>
+std::vector<typename with_segments<N, A>::template policy<LCP, T>::size_type>
+with_segments<N, A>::policy<LCP, T>::segment_sequence(
+        seq_type const &s, SegPosVec const &seg_pos_vec, double lrv_exp,
+        node_vec_type *nodes) const {
+    // normalization factors only depend on the length, so they are computed
+    // once per sequence instead of once per candidate word
+    std::array<double, N> f_scale, av_scale;
+    for (decltype(max_len_) m = 0; m < max_len_; ++m) {
+        auto num_str = static_cast<double>(num_str_[m]);
+        f_scale[m] = num_str / static_cast<double>(sum_f_[m]);
+        av_scale[m] = num_str / static_cast<double>(sum_av_[m]);
+    }
+
     auto n = s.size();
     std::vector<size_type> fs(n);
     std::vector<double> fv(n, -std::numeric_limits<double>::infinity());
@@ -235,14 +756,16 @@ with_segments<N>::policy<LCP, T>::segment_sequence(  // NOLINTNEXTLINE(runtime/r
         }
 
         auto s_it = s.begin() + i;
-        auto node = trie_.get_root();
-        auto max_m = std::min(n - i, N);
-        for (decltype(i) m = 0; m < max_m; ++m) {
+        auto node = trie_->get_root();
+        auto max_m = std::min(n - i, max_len_);
+        for (decltype(max_m) m = 0; m < max_m; ++m) {
             if (node) {
                 node = node->get(*s_it);
                 ++s_it;
             }
 
+            // once the trie misses, every longer candidate is scored as an
+            // unseen string, which is only allowed past the current word
             double f, avl, avr;
             if (node) {
                 f = static_cast<double>(node->f);
@@ -252,10 +775,9 @@ with_segments<N>::policy<LCP, T>::segment_sequence(  // NOLINTNEXTLINE(runtime/r
                 avl = avr = f = 1.0;
             } else { continue; }
 
-            auto num_str = static_cast<double>(num_str_[m]);
-            f *= num_str / static_cast<double>(sum_f_[m]);
-            avl *= num_str / static_cast<double>(sum_av_[m]);
-            avr *= num_str / static_cast<double>(sum_av_[m]);
+            f *= f_scale[m];
+            avl *= av_scale[m];
+            avr *= av_scale[m];
 
             auto score = (m + 1) * log(f) + lrv_exp * log(avl * avr);
             if (i == 0) {
@@ -263,6 +785,11 @@ with_segments<N>::policy<LCP, T>::segment_sequence(  // NOLINTNEXTLINE(runtime/r
             } else if (fv[i - 1] + score > fv[i + m]) {
                 fv[i + m] = fv[i - 1] + score;
                 fs[i + m] = i;
+            } else { continue; }
+
+            // keep the trie node of the best word ending at each position
+            if (nodes) {
+                (*nodes)[i + m] = node;
             }
         }
     }
@@ -270,34 +797,36 @@ with_segments<N>::policy<LCP, T>::segment_sequence(  // NOLINTNEXTLINE(runtime/r
     return fs;
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
-void with_segments<N>::policy<LCP, T>::increase_counts(
+void with_segments<N, A>::policy<LCP, T>::increase_counts(
         seq_type const &s, seg_pos_vec_type const &seg_pos_vec) {
     auto it = s.begin();
     typename seg_pos_vec_type::value_type prev_pos = 0;
     for (auto pos : seg_pos_vec) {
-        trie_.increase(it + prev_pos, it + pos);
+        trie_->increase(it + prev_pos, it + pos);
         prev_pos = pos;
     }
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
-void with_segments<N>::policy<LCP, T>::decrease_counts(
+void with_segments<N, A>::policy<LCP, T>::decrease_counts(
         seq_type const &s, seg_pos_vec_type const &seg_pos_vec) {
     auto it = s.begin();
     typename seg_pos_vec_type::value_type prev_pos = 0;
     for (auto pos : seg_pos_vec) {
-        trie_.decrease(it + prev_pos, it + pos);
+        trie_->decrease(it + prev_pos, it + pos);
         prev_pos = pos;
     }
 }
 
-template <std::size_t N>
+template <std::size_t N, typename A>
 template <typename LCP, typename T>
-void with_segments<N>::policy<LCP, T>::generate_seg_pos_vec(  // NOLINTNEXTLINE(runtime/references)
-        seg_pos_vec_type &seg_pos_vec, std::vector<size_type> const &fs) const {
+template <typename SegPosVec>
+void with_segments<N, A>::policy<LCP, T>::generate_seg_pos_vec(
+        SegPosVec &seg_pos_vec,  // NOLINT(runtime/references)
+        std::vector<size_type> const &fs) const {
     auto n = fs.size();
     seg_pos_vec.clear();
     seg_pos_vec.push_back(n);
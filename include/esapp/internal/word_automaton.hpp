@@ -0,0 +1,166 @@
+/************************************************
+ *  word_automaton.hpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#ifndef ESAPP_INTERNAL_WORD_AUTOMATON_HPP_
+#define ESAPP_INTERNAL_WORD_AUTOMATON_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace esapp {
+
+namespace internal {
+
+/************************************************
+ * Declaration: class word_automaton<T>
+ ************************************************/
+
+template <typename T>
+class word_automaton {
+ public:  // Public Type(s)
+    using term_type = T;
+    using size_type = std::size_t;
+    using word_type = std::vector<term_type>;
+
+ public:  // Public Method(s)
+    word_automaton();
+    explicit word_automaton(std::vector<word_type> words);
+
+    size_type size() const;
+    bool empty() const;
+
+    template <typename Iterator>
+    size_type match(Iterator begin, Iterator end) const;
+
+ private:  // Private Type(s)
+    using index_type = std::uint32_t;
+    struct state {
+        index_type first_edge, num_edges;
+        bool is_final;
+    };
+
+ private:  // Private Method(s)
+    void build(std::vector<word_type> const &words,
+               size_type lo, size_type hi, size_type depth, index_type s);
+    index_type next(index_type s, term_type c) const;
+
+ private:  // Private Property(ies)
+    size_type num_words_;
+    std::vector<state> states_;
+    std::vector<term_type> labels_;
+    std::vector<index_type> targets_;
+};  // class word_automaton<T>
+
+/************************************************
+ * Implementation: class word_automaton<T>
+ ************************************************/
+
+template <typename T>
+inline word_automaton<T>::word_automaton()
+    : num_words_(0), states_(1, state{0, 0, false}), labels_(), targets_() {
+    // do nothing
+}
+
+template <typename T>
+word_automaton<T>::word_automaton(std::vector<word_type> words)
+    : word_automaton() {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (!words.empty() && words.front().empty()) {
+        words.erase(words.begin());
+    }
+
+    num_words_ = words.size();
+    build(words, 0, words.size(), 0, 0);
+
+    labels_.shrink_to_fit();
+    targets_.shrink_to_fit();
+    states_.shrink_to_fit();
+}
+
+template <typename T>
+inline typename word_automaton<T>::size_type word_automaton<T>::size() const {
+    return num_words_;
+}
+
+template <typename T>
+inline bool word_automaton<T>::empty() const {
+    return num_words_ == 0;
+}
+
+template <typename T>
+template <typename Iterator>
+typename word_automaton<T>::size_type word_automaton<T>::match(Iterator begin,
+                                                               Iterator end) const {
+    // length of the longest word that is a prefix of [begin, end)
+    size_type len = 0, max_len = 0;
+    index_type s = 0;
+    for (auto it = begin; it != end; ++it) {
+        s = next(s, *it);
+        if (s == 0) { break; }
+
+        len++;
+        if (states_[s].is_final) {
+            max_len = len;
+        }
+    }
+
+    return max_len;
+}
+
+template <typename T>
+void word_automaton<T>::build(std::vector<word_type> const &words,
+                              size_type lo, size_type hi, size_type depth, index_type s) {
+    // words in [lo, hi) are sorted and share their first `depth` terms, so
+    // the outgoing edges of a state are laid out contiguously and in order
+    if (lo < hi && words[lo].size() == depth) {
+        states_[s].is_final = true;
+        lo++;
+    }
+
+    states_[s].first_edge = static_cast<index_type>(labels_.size());
+    for (auto i = lo; i < hi; ) {
+        auto c = words[i][depth];
+        labels_.push_back(c);
+        targets_.push_back(0);
+        while (i < hi && words[i][depth] == c) { i++; }
+    }
+
+    states_[s].num_edges = static_cast<index_type>(labels_.size()) - states_[s].first_edge;
+
+    auto edge = states_[s].first_edge;
+    for (auto i = lo; i < hi; edge++) {
+        auto j = i;
+        while (j < hi && words[j][depth] == words[i][depth]) { j++; }
+
+        auto t = static_cast<index_type>(states_.size());
+        states_.push_back(state{0, 0, false});
+        targets_[edge] = t;
+        build(words, i, j, depth + 1, t);
+
+        i = j;
+    }
+}
+
+template <typename T>
+inline typename word_automaton<T>::index_type word_automaton<T>::next(index_type s,
+                                                                      term_type c) const {
+    // state 0 is the root, which is never a target; it doubles as the
+    // result of a missing transition
+    auto first = labels_.begin() + states_[s].first_edge;
+    auto last = first + states_[s].num_edges;
+    auto it = std::lower_bound(first, last, c);
+    return (it != last && *it == c) ? targets_[it - labels_.begin()] : 0;
+}
+
+}  // namespace internal
+
+}  // namespace esapp
+
+#endif  // ESAPP_INTERNAL_WORD_AUTOMATON_HPP_
@@ -10,36 +10,94 @@
 #define ESAPP_SEGMENTER_HPP_
 
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
 #include <cwctype>
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <istream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <dict/text_index.hpp>
 #include <dict/with_lcp.hpp>
 
 #include "internal/with_segments.hpp"
+#include "internal/binary_io.hpp"
 #include "internal/decode_utf8.hpp"
+#include "internal/lru_cache.hpp"
 
 namespace esapp {
 
 /************************************************
- * Declaration: class segmenter
+ * Declaration: struct checkpoint_options
  ************************************************/
 
-class segmenter {
+struct checkpoint_options {
+    std::string path;
+    std::size_t every_n_iters = 0;
+    std::chrono::steady_clock::duration interval = std::chrono::steady_clock::duration::zero();
+};  // struct checkpoint_options
+
+/************************************************
+ * Declaration: class basic_segmenter<A>
+ ************************************************/
+
+// the allocator backs the trained state owned by the segmenter: the term id
+// map, the trie of counts and the segmentation of each fitted sequence;
+// the suffix index of dict::text_index, the outer list of segmentations,
+// the row and segment caches, and all the scratch storage of queries use
+// the global heap. trie nodes are still destroyed one at a time, so a
+// monotonic arena decides where the model lives, not how fast it goes away
+template <typename Allocator = std::allocator<char>>
+class basic_segmenter {
  public:  // Public Type(s)
     using size_type = std::size_t;
+    using allocator_type = Allocator;
+    using cache_stats = internal::cache_stats;
+
+ public:  // Public Static Property(ies)
+    static constexpr size_type default_max_word_length = 30;
+    static constexpr size_type unknown_word_id = 0;
 
  public:  // Public Method(s)
-    explicit segmenter(double lrv_exp);
+    explicit basic_segmenter(double lrv_exp, allocator_type const &alloc = allocator_type());
+    basic_segmenter(double lrv_exp, size_type max_word_length,
+                    allocator_type const &alloc = allocator_type());
+
+    allocator_type get_allocator() const;
+    size_type get_max_word_length() const;
+    void set_cache_capacity(size_type capacity, size_type num_shards = 16);
+    cache_stats get_cache_stats() const;
+
+    size_type get_num_sequences() const;
 
     template <typename ForwardIterator>
     void fit(ForwardIterator begin, ForwardIterator end);
+    // every call rebuilds the index from the retained sequences, which costs
+    // O(retained) time, so sequences should be evicted in large batches;
+    // term ids are never reclaimed, and fit() throws once they run out
+    void evict(size_type n_seqs);
+    template <typename InputIterator>
+    size_type warm_start(InputIterator first, InputIterator last);
+    size_type warm_start(basic_segmenter const &model);
     void optimize(size_type n_iters);
+    void optimize(size_type n_iters, checkpoint_options const &options);
+    void resume(checkpoint_options const &options);
+    template <typename RandomGenerator>
+    void optimize(size_type n_steps, size_type batch_size, RandomGenerator &&gen);
+    template <typename Schedule, typename RandomGenerator>
+    void optimize(size_type n_steps, size_type batch_size, Schedule schedule,
+                  RandomGenerator &&gen);
     template <typename WordType, typename ForwardIterator>
     [[deprecated]]
     std::vector<WordType> segment_into(ForwardIterator begin, ForwardIterator end) const;
@@ -48,26 +106,75 @@ class segmenter {
     std::vector<std::string> segment(ForwardIterator begin, ForwardIterator end) const;
     template <typename ForwardIterator, typename OutputIterator>
     OutputIterator segment(ForwardIterator it, ForwardIterator end, OutputIterator d_it) const;
+    template <typename ForwardIterator, typename OutputIterator>
+    OutputIterator segment_ids(ForwardIterator it, ForwardIterator end,
+                               OutputIterator d_it) const;
+
+    size_type build_vocabulary();
+    size_type get_vocabulary_size() const;
+
+    void save(std::ostream &os) const;  // NOLINT(runtime/references)
+    void load(std::istream &is);  // NOLINT(runtime/references)
 
  private:  // Private Type(s)
     using text_index = dict::text_index<
         dict::with_lcp<
-            internal::with_segments<30>::policy
-        >::policy
+            internal::with_segments<default_max_word_length, Allocator>::template policy
+        >::template policy
     >;
-    using term_id = text_index::term_type;
+    using term_id = typename text_index::term_type;
     using term_type = char32_t;
+    using term_id_map = std::unordered_map<
+        term_type, term_id, std::hash<term_type>, std::equal_to<term_type>,
+        typename std::allocator_traits<Allocator>::template rebind_alloc<
+            std::pair<term_type const, term_id>
+        >
+    >;
+    using token_type = std::vector<term_id>;
+    enum : std::uint32_t {
+        model_magic = 0x2B415345,  // "ESA+"
+        checkpoint_magic = 0x43415345,  // "ESAC"
+        model_version = 1
+    };
+    using segment_cache = internal::lru_cache<
+        token_type,
+        std::vector<typename text_index::size_type>,
+        internal::sequence_hash<token_type>
+    >;
 
  private:  // Private Static Method(s)
     template <typename ForwardIterator, typename Predicate>  // NOLINTNEXTLINE(runtime/references)
     static term_type scan_while(ForwardIterator &scanned_it, ForwardIterator &it,
                                 ForwardIterator end, Predicate f);
+    static void check_header(std::istream &is, std::uint32_t magic);  // NOLINT(runtime/references)
+    static void check_options(checkpoint_options const &options);
+
+ private:  // Private Method(s)
+    template <typename ForwardIterator, typename RunHandler, typename WordHandler>
+    void tokenize(ForwardIterator it, ForwardIterator end,
+                  RunHandler on_run, WordHandler on_word) const;
+    template <typename ForwardIterator>  // NOLINTNEXTLINE(runtime/references)
+    bool encode_word(ForwardIterator it, ForwardIterator end, token_type &token) const;
+    size_type seed_segmentation(std::vector<token_type> &&words);
+    void save_terms(std::ostream &os) const;  // NOLINT(runtime/references)
+    term_id_map load_terms(std::istream &is) const;  // NOLINT(runtime/references)
+    void optimize_from(size_type first_iter, size_type first_seq, size_type n_iters,
+                       checkpoint_options const &options);
+    void save_checkpoint(std::string const &path, size_type n_iters_done,
+                         size_type n_iters_left, size_type n_seqs_done) const;
 
  private:  // Private Property(ies)
     double lrv_exp_;
-    std::unordered_map<term_type, term_id> term_id_map_;
+    term_id_map term_id_map_;
     text_index index_;
-};  // class segmenter
+    mutable segment_cache cache_;
+};  // class basic_segmenter<A>
+
+/************************************************
+ * Declaration: type segmenter
+ ************************************************/
+
+using segmenter = basic_segmenter<>;
 
 /************************************************
  * Inline Helper Function(s)
@@ -89,61 +196,313 @@ inline bool isfwalnum(char32_t c) {
 }
 
 /************************************************
- * Implementation: class segmenter
+ * Implementation: class basic_segmenter<A>
  ************************************************/
 
-inline segmenter::segmenter(double lrv_exp)
-    : lrv_exp_(lrv_exp), term_id_map_({{0, 0}}) {
+template <typename A>
+constexpr typename basic_segmenter<A>::size_type basic_segmenter<A>::default_max_word_length;
+
+template <typename A>
+constexpr typename basic_segmenter<A>::size_type basic_segmenter<A>::unknown_word_id;
+
+template <typename A>
+inline basic_segmenter<A>::basic_segmenter(double lrv_exp, allocator_type const &alloc)
+    : basic_segmenter(lrv_exp, default_max_word_length, alloc) {
     // do nothing
 }
 
+template <typename A>
+inline basic_segmenter<A>::basic_segmenter(double lrv_exp, size_type max_word_length,
+                                           allocator_type const &alloc)
+    : lrv_exp_(lrv_exp), term_id_map_(alloc), index_(), cache_() {
+    term_id_map_.emplace(0, 0);
+    index_.reset_allocator(alloc);
+    index_.set_max_length(max_word_length);
+}
+
+template <typename A>
+inline typename basic_segmenter<A>::allocator_type basic_segmenter<A>::get_allocator() const {
+    return index_.get_allocator();
+}
+
+template <typename A>
+inline typename basic_segmenter<A>::size_type basic_segmenter<A>::get_max_word_length() const {
+    return index_.get_max_length();
+}
+
+template <typename A>
+inline void basic_segmenter<A>::set_cache_capacity(size_type capacity, size_type num_shards) {
+    cache_ = segment_cache(capacity, num_shards);
+}
+
+template <typename A>
+inline typename basic_segmenter<A>::cache_stats basic_segmenter<A>::get_cache_stats() const {
+    return cache_.stats();
+}
+
+template <typename A>
+inline typename basic_segmenter<A>::size_type basic_segmenter<A>::get_num_sequences() const {
+    return index_.get_num_sequences();
+}
+
+template <typename A>
 template <typename ForwardIterator>
-void segmenter::fit(ForwardIterator it, ForwardIterator end) {
-    term_id id = term_id_map_.size();
-    std::vector<term_id> token;
+void basic_segmenter<A>::fit(ForwardIterator it, ForwardIterator end) {
+    // decode the whole input before touching the model, so that invalid
+    // input throws without leaving any of its runs or terms behind
+    std::vector<term_type> terms;
+    std::vector<size_type> run_ends;
     while (it != end) {
         auto term = internal::decode_utf8<term_type>(it, end);
         if (iscjk(term)) {
-            token.clear();
             do {
-                if (term_id_map_.find(term) == term_id_map_.end()) {
-                    term_id_map_.emplace(term, id++);
-                }
-
-                token.push_back(term_id_map_[term]);
+                terms.push_back(term);
             } while (it != end && iscjk(term = internal::decode_utf8<term_type>(it, end)));
 
-            index_.insert(token);
+            run_ends.push_back(terms.size());
         }
     }
+
+    // term ids are not reclaimed by evict(), so a long-running stream of new
+    // characters eventually exhausts them; fail before wrapping into the
+    // sentinel id 0
+    std::vector<term_type> new_terms;
+    for (auto term : terms) {
+        if (term_id_map_.find(term) == term_id_map_.end()) {
+            new_terms.push_back(term);
+        }
+    }
+
+    std::sort(new_terms.begin(), new_terms.end());
+    new_terms.erase(std::unique(new_terms.begin(), new_terms.end()), new_terms.end());
+    if (new_terms.size() > std::numeric_limits<term_id>::max() - (term_id_map_.size() - 1)) {
+        throw std::length_error("Too many distinct characters");
+    }
+
+    term_id id = term_id_map_.size();
+    token_type token;
+    size_type run_begin = 0;
+    for (auto run_end : run_ends) {
+        token.clear();
+        for (auto i = run_begin; i < run_end; i++) {
+            auto result = term_id_map_.emplace(terms[i], id);
+            if (result.second) { id++; }
+
+            token.push_back(result.first->second);
+        }
+
+        index_.insert(token);
+        run_begin = run_end;
+    }
+
+    cache_.clear();
+}
+
+template <typename A>
+inline void basic_segmenter<A>::evict(size_type n_seqs) {
+    // sequences are the CJK runs inserted by fit(), oldest first; compare
+    // get_num_sequences() before and after fit() to evict whole inputs
+    index_.evict(n_seqs);
+    cache_.clear();
 }
 
-inline void segmenter::optimize(size_type n_iters) {
+template <typename A>
+template <typename InputIterator>
+typename basic_segmenter<A>::size_type basic_segmenter<A>::warm_start(InputIterator first,
+                                                                      InputIterator last) {
+    // words that cannot occur in the fitted sequences are left out
+    std::vector<token_type> words;
+    token_type token;
+    for (; first != last; ++first) {
+        using std::begin;
+        using std::end;
+        if (encode_word(begin(*first), end(*first), token)) {
+            words.push_back(token);
+        }
+    }
+
+    return seed_segmentation(std::move(words));
+}
+
+template <typename A>
+typename basic_segmenter<A>::size_type basic_segmenter<A>::warm_start(
+        basic_segmenter const &model) {
+    if (model.get_vocabulary_size() <= 1) {
+        throw std::logic_error("Model has no vocabulary");
+    }
+
+    // the vocabulary of the model is in its own term ids, so map them to
+    // the ones of this segmenter
+    std::unordered_map<term_id, term_id> term_ids;
+    for (auto const &p : model.term_id_map_) {
+        auto it = term_id_map_.find(p.first);
+        if (it != term_id_map_.end()) {
+            term_ids.emplace(p.second, it->second);
+        }
+    }
+
+    std::vector<token_type> words;
+    model.index_.for_each_word([&](std::vector<term_id> const &word) {
+        if (word.size() > get_max_word_length()) { return; }
+
+        token_type token;
+        for (auto c : word) {
+            auto it = term_ids.find(c);
+            if (it == term_ids.end()) { return; }
+
+            token.push_back(it->second);
+        }
+
+        words.push_back(std::move(token));
+    });
+
+    return seed_segmentation(std::move(words));
+}
+
+template <typename A>
+inline void basic_segmenter<A>::optimize(size_type n_iters) {
     index_.optimize(lrv_exp_, n_iters);
+    cache_.clear();
+}
+
+template <typename A>
+inline void basic_segmenter<A>::optimize(size_type n_iters, checkpoint_options const &options) {
+    check_options(options);
+    optimize_from(0, 0, n_iters, options);
 }
 
+template <typename A>
+void basic_segmenter<A>::resume(checkpoint_options const &options) {
+    check_options(options);
+    std::ifstream is(options.path, std::ios::binary);
+    if (!is) {
+        throw std::runtime_error("Cannot open checkpoint: " + options.path);
+    }
+
+    check_header(is, checkpoint_magic);
+    auto n_iters_done = internal::read_binary<std::uint64_t>(is);
+    auto n_iters_left = internal::read_binary<std::uint64_t>(is);
+    auto n_seqs_done = internal::read_binary<std::uint64_t>(is);
+    auto lrv_exp = internal::read_binary<double>(is);
+    auto term_id_map = load_terms(is);
+
+    index_.load_state(is);
+    lrv_exp_ = lrv_exp;
+    term_id_map_.swap(term_id_map);
+    cache_.clear();
+
+    optimize_from(n_iters_done, n_seqs_done, n_iters_left, options);
+}
+
+template <typename A>
+template <typename RandomGenerator>
+inline void basic_segmenter<A>::optimize(size_type n_steps, size_type batch_size,
+                                         RandomGenerator &&gen) {
+    optimize(n_steps, batch_size, [](size_type, size_type n) { return n; },
+             std::forward<RandomGenerator>(gen));
+}
+
+template <typename A>
+template <typename Schedule, typename RandomGenerator>
+inline void basic_segmenter<A>::optimize(size_type n_steps, size_type batch_size,
+                                         Schedule schedule, RandomGenerator &&gen) {
+    index_.optimize(lrv_exp_, n_steps, batch_size, schedule, gen);
+    cache_.clear();
+}
+
+template <typename A>
 template <typename WordType, typename ForwardIterator>
-inline std::vector<WordType> segmenter::segment_into(
+inline std::vector<WordType> basic_segmenter<A>::segment_into(
         ForwardIterator begin, ForwardIterator end) const {
     decltype(segment_into<WordType>(begin, end)) words;
     segment(begin, end, std::inserter(words, words.end()));
     return words;
 }
 
+template <typename A>
 template <typename ForwardIterator>
-inline std::vector<std::string> segmenter::segment(
+inline std::vector<std::string> basic_segmenter<A>::segment(
         ForwardIterator begin, ForwardIterator end) const {
     return segment_into<std::string>(begin, end);
 }
 
+template <typename A>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator basic_segmenter<A>::segment(ForwardIterator it, ForwardIterator end,
+                                           OutputIterator d_it) const {
+    std::vector<typename text_index::size_type> seg_pos_vec;
+    tokenize(it, end, [&](ForwardIterator word_begin, token_type const &token) {
+        if (!cache_.get(token, seg_pos_vec)) {
+            seg_pos_vec = index_.segment(token, lrv_exp_);
+            cache_.put(token, seg_pos_vec);
+        }
+
+        typename decltype(seg_pos_vec)::value_type prev_pos = 0;
+        for (auto pos : seg_pos_vec) {
+            assert(pos > prev_pos);
+            *d_it++ = {word_begin + prev_pos * 3, word_begin + pos * 3};
+            prev_pos = pos;
+        }
+    }, [&](ForwardIterator word_begin, ForwardIterator word_end) {
+        *d_it++ = {word_begin, word_end};
+    });
+
+    return d_it;
+}
+
+template <typename A>
 template <typename ForwardIterator, typename OutputIterator>
-OutputIterator segmenter::segment(ForwardIterator it, ForwardIterator end,
-                                  OutputIterator d_it) const {
-    if (it == end) { return d_it; }
+OutputIterator basic_segmenter<A>::segment_ids(ForwardIterator it, ForwardIterator end,
+                                               OutputIterator d_it) const {
+    tokenize(it, end, [&](ForwardIterator, token_type const &token) {
+        d_it = index_.segment_ids(token, lrv_exp_, d_it);
+    }, [&](ForwardIterator, ForwardIterator) {
+        *d_it++ = unknown_word_id;
+    });
+
+    return d_it;
+}
+
+template <typename A>
+inline typename basic_segmenter<A>::size_type basic_segmenter<A>::build_vocabulary() {
+    return index_.build_vocabulary();
+}
+
+template <typename A>
+inline typename basic_segmenter<A>::size_type basic_segmenter<A>::get_vocabulary_size() const {
+    return index_.get_vocabulary_size();
+}
+
+template <typename A>  // NOLINTNEXTLINE(runtime/references)
+void basic_segmenter<A>::save(std::ostream &os) const {
+    internal::write_binary<std::uint32_t>(os, model_magic);
+    internal::write_binary<std::uint32_t>(os, model_version);
+    internal::write_binary<double>(os, lrv_exp_);
+    save_terms(os);
+    index_.save(os);
+}
+
+template <typename A>  // NOLINTNEXTLINE(runtime/references)
+void basic_segmenter<A>::load(std::istream &is) {
+    check_header(is, model_magic);
+    auto lrv_exp = internal::read_binary<double>(is);
+    auto term_id_map = load_terms(is);
+
+    index_.load(is);
+    lrv_exp_ = lrv_exp;
+    term_id_map_.swap(term_id_map);
+    cache_.clear();
+}
+
+template <typename A>
+template <typename ForwardIterator, typename RunHandler, typename WordHandler>
+void basic_segmenter<A>::tokenize(ForwardIterator it, ForwardIterator end,
+                                  RunHandler on_run, WordHandler on_word) const {
+    if (it == end) { return; }
 
     auto word_begin = it;
     auto term = internal::decode_utf8<term_type>(it, end);
-    std::vector<term_id> token;
+    token_type token;
     while (it != end) {
         auto word_end = it;
         if (iscjk(term)) {
@@ -158,13 +517,7 @@ OutputIterator segmenter::segment(ForwardIterator it, ForwardIterator end,
                 }
             } while (it != end && iscjk(term = internal::decode_utf8<term_type>(it, end)));
 
-            auto seg_pos_vec = index_.segment(token, lrv_exp_);
-            decltype(seg_pos_vec)::value_type prev_pos = 0;
-            for (auto pos : seg_pos_vec) {
-                assert(pos > prev_pos);
-                *d_it++ = {word_begin + prev_pos * 3, word_begin + pos * 3};
-                prev_pos = pos;
-            }
+            on_run(word_begin, token);
         } else if (std::iswspace(term)) {
             term = scan_while(it, word_end, end, std::iswspace);
         } else {
@@ -177,22 +530,22 @@ OutputIterator segmenter::segment(ForwardIterator it, ForwardIterator end,
             }
 
             assert(word_begin != word_end);
-            *d_it++ = {word_begin, word_end};
+            on_word(word_begin, word_end);
         }
 
         word_begin = word_end;
     }
 
     if (word_begin != it) {
-        *d_it++ = {word_begin, it};
+        on_word(word_begin, it);
     }
-
-    return d_it;
 }
 
+template <typename A>
 template <typename ForwardIterator, typename Predicate>
-segmenter::term_type segmenter::scan_while(ForwardIterator &scanned_it, ForwardIterator &it,
-                                           ForwardIterator end, Predicate f) {
+typename basic_segmenter<A>::term_type basic_segmenter<A>::scan_while(
+        ForwardIterator &scanned_it, ForwardIterator &it,  // NOLINT(runtime/references)
+        ForwardIterator end, Predicate f) {
     assert(scanned_it != end);
 
     term_type term;
@@ -204,6 +557,126 @@ segmenter::term_type segmenter::scan_while(ForwardIterator &scanned_it, ForwardI
     return term;
 }
 
+template <typename A>  // NOLINTNEXTLINE(runtime/references)
+void basic_segmenter<A>::check_header(std::istream &is, std::uint32_t magic) {
+    if (internal::read_binary<std::uint32_t>(is) != magic) {
+        throw internal::invalid_model_data("Not an ESA++ model or checkpoint");
+    } else if (internal::read_binary<std::uint32_t>(is) != model_version) {
+        throw internal::invalid_model_data("Unsupported model version");
+    }
+}
+
+template <typename A>
+void basic_segmenter<A>::check_options(checkpoint_options const &options) {
+    // reject the options before any work is done, rather than failing at the
+    // first checkpoint in the middle of optimization
+    auto saves = options.every_n_iters > 0 || options.interval > options.interval.zero();
+    if (saves && options.path.empty()) {
+        throw std::invalid_argument("Checkpoint path is empty");
+    }
+}
+
+template <typename A>
+template <typename ForwardIterator>  // NOLINTNEXTLINE(runtime/references)
+bool basic_segmenter<A>::encode_word(ForwardIterator it, ForwardIterator end,
+                                     token_type &token) const {
+    token.clear();
+    while (it != end) {
+        auto term = internal::decode_utf8<term_type>(it, end);
+        auto term_id_it = term_id_map_.find(term);
+        if (!iscjk(term) || term_id_it == term_id_map_.end()
+                || token.size() == get_max_word_length()) {
+            return false;
+        }
+
+        token.push_back(term_id_it->second);
+    }
+
+    return !token.empty();
+}
+
+template <typename A>
+typename basic_segmenter<A>::size_type basic_segmenter<A>::seed_segmentation(
+        std::vector<token_type> &&words) {
+    typename text_index::automaton_type automaton(std::move(words));
+    index_.warm_start(automaton);
+    cache_.clear();
+    return automaton.size();
+}
+
+template <typename A>  // NOLINTNEXTLINE(runtime/references)
+void basic_segmenter<A>::save_terms(std::ostream &os) const {
+    internal::write_binary<std::uint64_t>(os, term_id_map_.size());
+    for (auto const &p : term_id_map_) {
+        internal::write_binary<std::uint32_t>(os, p.first);
+        internal::write_binary<term_id>(os, p.second);
+    }
+}
+
+template <typename A>  // NOLINTNEXTLINE(runtime/references)
+typename basic_segmenter<A>::term_id_map basic_segmenter<A>::load_terms(std::istream &is) const {
+    term_id_map term_id_map(term_id_map_.get_allocator());
+    auto n = internal::read_binary<std::uint64_t>(is);
+    for (decltype(n) i = 0; i < n; i++) {
+        auto term = internal::read_binary<std::uint32_t>(is);
+        term_id_map.emplace(term, internal::read_binary<term_id>(is));
+    }
+
+    return term_id_map;
+}
+
+template <typename A>
+void basic_segmenter<A>::optimize_from(size_type first_iter, size_type first_seq,
+                                       size_type n_iters, checkpoint_options const &options) {
+    // the time budget is checked after every sequence, since a single pass
+    // over a large corpus may take much longer than the interval
+    auto timed = options.interval > options.interval.zero();
+    auto last = std::chrono::steady_clock::now();
+    index_.optimize(lrv_exp_, n_iters, first_seq, [&](size_type n_iters_done,
+                                                      size_type n_seqs_done) {
+        if (n_iters_done == n_iters) { return; }
+
+        // iterations are counted from the start of the original run, so a
+        // resumed run keeps the cadence of the one it continues
+        auto by_iters = options.every_n_iters > 0 && n_seqs_done == 0
+            && (first_iter + n_iters_done) % options.every_n_iters == 0;
+        if (by_iters || (timed && std::chrono::steady_clock::now() - last >= options.interval)) {
+            save_checkpoint(options.path, first_iter + n_iters_done, n_iters - n_iters_done,
+                            n_seqs_done);
+            last = std::chrono::steady_clock::now();
+        }
+    });
+
+    cache_.clear();
+}
+
+template <typename A>
+void basic_segmenter<A>::save_checkpoint(std::string const &path, size_type n_iters_done,
+                                         size_type n_iters_left,
+                                         size_type n_seqs_done) const {
+    // write to a temporary file first, so that a preempted write never
+    // leaves a truncated checkpoint behind
+    auto tmp_path = path + ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::binary);
+        internal::write_binary<std::uint32_t>(os, checkpoint_magic);
+        internal::write_binary<std::uint32_t>(os, model_version);
+        internal::write_binary<std::uint64_t>(os, n_iters_done);
+        internal::write_binary<std::uint64_t>(os, n_iters_left);
+        internal::write_binary<std::uint64_t>(os, n_seqs_done);
+        internal::write_binary<double>(os, lrv_exp_);
+        save_terms(os);
+        index_.save_state(os);
+        if (!os.flush()) {
+            throw std::runtime_error("Cannot write checkpoint: " + tmp_path);
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot write checkpoint: " + path);
+    }
+}
+
 }  // namespace esapp
 
 #endif  // ESAPP_SEGMENTER_HPP_
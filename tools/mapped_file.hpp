@@ -0,0 +1,102 @@
+/************************************************
+ *  mapped_file.hpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#ifndef ESAPP_TOOLS_MAPPED_FILE_HPP_
+#define ESAPP_TOOLS_MAPPED_FILE_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+namespace esapp {
+
+namespace tools {
+
+/************************************************
+ * Declaration: class mapped_file
+ ************************************************/
+
+class mapped_file {
+ public:  // Public Method(s)
+    explicit mapped_file(std::string const &path);
+    mapped_file(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file const &) = delete;
+    ~mapped_file();
+
+    char const *begin() const;
+    char const *end() const;
+    std::size_t size() const;
+
+ private:  // Private Property(ies)
+    char const *data_;
+    std::size_t size_;
+};  // class mapped_file
+
+/************************************************
+ * Implementation: class mapped_file
+ ************************************************/
+
+inline mapped_file::mapped_file(std::string const &path)
+    : data_(nullptr), size_(0) {
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        auto error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), path);
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0) {
+        auto p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            auto error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<char const *>(p);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+inline mapped_file::~mapped_file() {
+    if (data_) {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+inline char const *mapped_file::begin() const {
+    return data_;
+}
+
+inline char const *mapped_file::end() const {
+    return data_ + size_;
+}
+
+inline std::size_t mapped_file::size() const {
+    return size_;
+}
+
+}  // namespace tools
+
+}  // namespace esapp
+
+#endif  // ESAPP_TOOLS_MAPPED_FILE_HPP_
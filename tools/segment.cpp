@@ -0,0 +1,345 @@
+/************************************************
+ *  segment.cpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <esapp/segmenter.hpp>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t chunk_size = 1 << 20;
+constexpr std::size_t output_buffer_size = 1 << 22;
+
+/************************************************
+ * Declaration: struct chunk
+ ************************************************/
+
+struct chunk {
+    std::size_t seq;
+    std::string data;
+};  // struct chunk
+
+/************************************************
+ * Declaration: class bounded_queue
+ ************************************************/
+
+class bounded_queue {
+ public:  // Public Method(s)
+    explicit bounded_queue(std::size_t capacity)
+        : capacity_(capacity), closed_(false) { /* do nothing */ }
+
+    void push(chunk &&c) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return queue_.size() < capacity_; });
+        queue_.push_back(std::move(c));
+        not_empty_.notify_one();
+    }
+
+    bool pop(chunk &c) {  // NOLINT(runtime/references)
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !queue_.empty() || closed_; });
+        if (queue_.empty()) { return false; }
+
+        c = std::move(queue_.front());
+        queue_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+ private:  // Private Property(ies)
+    std::size_t capacity_;
+    bool closed_;
+    std::deque<chunk> queue_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+};  // class bounded_queue
+
+/************************************************
+ * Declaration: class ordered_writer
+ ************************************************/
+
+class ordered_writer {
+ public:  // Public Method(s)
+    ordered_writer(std::FILE *out, std::size_t window)
+        : out_(out), window_(window), next_(0), total_(-1) { /* do nothing */ }
+
+    // blocks while the chunk is too far ahead of the one to be written next,
+    // which bounds the number of pending chunks
+    void put(chunk &&c) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this, &c] { return c.seq < next_ + window_; });
+        pending_.emplace(c.seq, std::move(c.data));
+        ready_.notify_one();
+    }
+
+    void finish(std::size_t total) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        total_ = total;
+        ready_.notify_one();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            ready_.wait(lock, [this] {
+                return pending_.count(next_) > 0 || next_ == total_;
+            });
+            if (next_ == total_) { break; }
+
+            auto data = std::move(pending_[next_]);
+            pending_.erase(next_);
+
+            lock.unlock();
+            std::fwrite(data.data(), 1, data.size(), out_);
+            lock.lock();
+
+            next_++;
+            not_full_.notify_all();
+        }
+
+        std::fflush(out_);
+    }
+
+ private:  // Private Property(ies)
+    std::FILE *out_;
+    std::size_t window_;
+    std::size_t next_;
+    std::size_t total_;
+    std::map<std::size_t, std::string> pending_;
+    std::mutex mutex_;
+    std::condition_variable ready_, not_full_;
+};  // class ordered_writer
+
+/************************************************
+ * Declaration: class word_appender
+ ************************************************/
+
+class word_appender {
+ public:  // Public Method(s)
+    word_appender(std::string &out, std::string const &delim)  // NOLINT(runtime/references)
+        : out_(out), delim_(delim), first_(true) { /* do nothing */ }
+
+    word_appender &operator=(std::pair<char const *, char const *> const &word) {
+        if (!first_) { out_ += delim_; }
+        out_.append(word.first, word.second);
+        first_ = false;
+        return *this;
+    }
+
+    word_appender &operator*()       { return *this; }
+    word_appender &operator++()      { return *this; }
+    word_appender &operator++(int)   { return *this; }
+
+ private:  // Private Property(ies)
+    std::string &out_;
+    std::string const &delim_;
+    bool first_;
+};  // class word_appender
+
+/************************************************
+ * Helper Function(s)
+ ************************************************/
+
+// memrchr() is a GNU extension, so the last newline is searched by hand
+char const *find_last_newline(char const *data, std::size_t n) {
+    for (auto p = data + n; p != data; ) {
+        if (*--p == '\n') { return p; }
+    }
+
+    return nullptr;
+}
+
+// read input in chunks of whole lines, returning the number of chunks
+std::size_t read_chunks(std::FILE *in, std::size_t seq, bounded_queue &queue,  // NOLINT
+                        std::size_t &n_bytes) {  // NOLINT(runtime/references)
+    std::string carry;
+    std::vector<char> buf(chunk_size);
+    std::size_t n;
+    while ((n = std::fread(buf.data(), 1, buf.size(), in)) > 0) {
+        n_bytes += n;
+
+        auto last_newline = find_last_newline(buf.data(), n);
+        if (!last_newline) {
+            carry.append(buf.data(), n);
+            continue;
+        }
+
+        auto head = static_cast<std::size_t>(last_newline - buf.data()) + 1;
+        chunk c{seq++, std::move(carry)};
+        c.data.append(buf.data(), head);
+        queue.push(std::move(c));
+
+        carry.assign(buf.data() + head, n - head);
+    }
+
+    if (!carry.empty()) {
+        carry.push_back('\n');
+        queue.push({seq++, std::move(carry)});
+    }
+
+    return seq;
+}
+
+void segment_chunks(esapp::segmenter const &seg, std::string const &delim,
+                    bounded_queue &queue, ordered_writer &writer,  // NOLINT(runtime/references)
+                    std::size_t &n_errors) {  // NOLINT(runtime/references)
+    chunk in, out;
+    while (queue.pop(in)) {
+        out.seq = in.seq;
+        out.data.clear();
+        out.data.reserve(in.data.size() + in.data.size() / 2);
+
+        auto it = in.data.data(), end = it + in.data.size();
+        while (it != end) {
+            auto line_end = static_cast<char const *>(std::memchr(it, '\n', end - it));
+            auto size = out.data.size();
+            try {
+                seg.segment(it, line_end, word_appender(out.data, delim));
+            } catch (esapp::internal::invalid_byte_sequence const &) {
+                n_errors++;
+                out.data.resize(size);
+                out.data.append(it, line_end);
+            } catch (std::out_of_range const &) {
+                n_errors++;
+                out.data.resize(size);
+                out.data.append(it, line_end);
+            }
+
+            out.data.push_back('\n');
+            it = line_end + 1;
+        }
+
+        writer.put(std::move(out));
+    }
+}
+
+void usage(char const *prog) {
+    std::cerr << "usage: " << prog
+              << " [-j n_threads] [-d delimiter] model_file [input_file...]" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string delim = " ";
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "j:d:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            n_threads = std::max(1ul, std::strtoul(optarg, nullptr, 10));
+            break;
+        case 'd':
+            delim = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    esapp::segmenter seg(0);
+    try {
+        std::ifstream is(argv[optind++], std::ios::binary);
+        if (!is) {
+            throw std::runtime_error(std::string("Cannot open model file: ") + argv[optind - 1]);
+        }
+
+        seg.load(is);
+    } catch (std::exception const &e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<char> out_buf(output_buffer_size);
+    std::setvbuf(stdout, out_buf.data(), _IOFBF, out_buf.size());
+
+    // reader -> segmenter pool -> ordered writer; every stage is bounded,
+    // so memory use does not depend on the size of the input
+    bounded_queue queue(2 * n_threads);
+    ordered_writer writer(stdout, 4 * n_threads);
+    std::vector<std::size_t> n_errors(n_threads, 0);
+
+    auto start = clock_type::now();
+    std::thread writer_thread(&ordered_writer::run, &writer);
+    std::vector<std::thread> workers;
+    for (decltype(n_threads) i = 0; i < n_threads; i++) {
+        workers.emplace_back(segment_chunks, std::cref(seg), std::cref(delim),
+                             std::ref(queue), std::ref(writer), std::ref(n_errors[i]));
+    }
+
+    auto status = EXIT_SUCCESS;
+    std::size_t n_chunks = 0, n_bytes = 0;
+    if (optind >= argc) {
+        n_chunks = read_chunks(stdin, n_chunks, queue, n_bytes);
+    }
+
+    for (auto i = optind; i < argc; i++) {
+        auto in = std::fopen(argv[i], "rb");
+        if (!in) {
+            std::cerr << argv[0] << ": cannot open " << argv[i] << std::endl;
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        n_chunks = read_chunks(in, n_chunks, queue, n_bytes);
+        std::fclose(in);
+    }
+
+    queue.close();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    writer.finish(n_chunks);
+    writer_thread.join();
+
+    auto elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    std::cerr << "segment: " << n_bytes << " bytes in " << elapsed << " s ("
+              << n_bytes / elapsed / 1e6 << " MB/s, " << n_threads << " threads)";
+
+    std::size_t total_errors = 0;
+    for (auto n : n_errors) { total_errors += n; }
+    if (total_errors > 0) {
+        std::cerr << ", " << total_errors << " lines with invalid UTF-8";
+    }
+
+    std::cerr << std::endl;
+    return status;
+}
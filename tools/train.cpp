@@ -0,0 +1,238 @@
+/************************************************
+ *  train.cpp
+ *  ESA++
+ *
+ *  Copyright (c) 2014-2017, Chi-En Wu
+ *  Distributed under The BSD 3-Clause License
+ ************************************************/
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <esapp/segmenter.hpp>
+
+#include "mapped_file.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+void fit_corpora(esapp::segmenter &seg,  // NOLINT(runtime/references)
+                 char const * const *first, char const * const *last) {
+    // map every corpus up front, so that the kernel can read ahead the
+    // next file while the current one is being fitted
+    std::vector<std::unique_ptr<esapp::tools::mapped_file>> files;
+    for (auto it = first; it != last; ++it) {
+        files.emplace_back(new esapp::tools::mapped_file(*it));
+    }
+
+    std::size_t n_bytes = 0, n_lines = 0, n_errors = 0;
+    auto start = clock_type::now();
+    for (decltype(files.size()) i = 0; i < files.size(); i++) {
+        if (i + 1 < files.size() && files[i + 1]->size() > 0) {
+            ::madvise(const_cast<char *>(files[i + 1]->begin()),
+                      files[i + 1]->size(), MADV_WILLNEED);
+        }
+
+        auto it = files[i]->begin(), end = files[i]->end();
+        while (it != end) {
+            auto line_end = static_cast<char const *>(std::memchr(it, '\n', end - it));
+            if (!line_end) { line_end = end; }
+
+            try {
+                seg.fit(it, line_end);
+            } catch (esapp::internal::invalid_byte_sequence const &) {
+                n_errors++;
+            } catch (std::out_of_range const &) {
+                n_errors++;
+            }
+
+            n_lines++;
+            it = (line_end == end) ? end : line_end + 1;
+        }
+
+        n_bytes += files[i]->size();
+    }
+
+    auto elapsed = seconds_since(start);
+    std::cerr << "fit: " << n_lines << " lines, " << n_bytes << " bytes in "
+              << elapsed << " s (" << n_bytes / elapsed / 1e6 << " MB/s)";
+    if (n_errors > 0) {
+        std::cerr << ", " << n_errors << " lines with invalid UTF-8";
+    }
+
+    std::cerr << std::endl;
+}
+
+std::vector<std::string> read_lexicon(std::string const &path) {
+    std::ifstream is(path);
+    if (!is) {
+        throw std::runtime_error("Cannot open lexicon file: " + path);
+    }
+
+    std::vector<std::string> words;
+    std::string word;
+    while (std::getline(is, word)) {
+        if (!word.empty()) { words.push_back(word); }
+    }
+
+    return words;
+}
+
+void warm_start(esapp::segmenter &seg,  // NOLINT(runtime/references)
+                std::string const &lexicon_path, std::string const &init_model_path) {
+    auto start = clock_type::now();
+    std::size_t n_words;
+    if (!lexicon_path.empty()) {
+        auto words = read_lexicon(lexicon_path);
+        n_words = seg.warm_start(words.begin(), words.end());
+    } else if (!init_model_path.empty()) {
+        std::ifstream is(init_model_path, std::ios::binary);
+        if (!is) {
+            throw std::runtime_error("Cannot open model file: " + init_model_path);
+        }
+
+        esapp::segmenter model(0);
+        model.load(is);
+        n_words = seg.warm_start(model);
+    } else {
+        return;
+    }
+
+    std::cerr << "warm start: " << n_words << " words in "
+              << seconds_since(start) << " s" << std::endl;
+}
+
+void usage(char const *prog) {
+    std::cerr << "usage: " << prog
+              << " [-e lrv_exp] [-m max_word_length] [-n n_iters]"
+              << " [-c checkpoint_file (-k every_n_iters | -t every_n_seconds)]"
+              << " [-l lexicon_file | -i init_model_file]"
+              << " -o model_file corpus_file..." << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    double lrv_exp = 0.1;
+    std::size_t max_word_length = esapp::segmenter::default_max_word_length;
+    std::size_t n_iters = 10;
+    std::string model_path, lexicon_path, init_model_path;
+    esapp::checkpoint_options checkpoint;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "e:m:n:o:c:k:t:l:i:h")) != -1) {
+        switch (opt) {
+        case 'e':
+            lrv_exp = std::strtod(optarg, nullptr);
+            break;
+        case 'm':
+            max_word_length = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            n_iters = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'o':
+            model_path = optarg;
+            break;
+        case 'c':
+            checkpoint.path = optarg;
+            break;
+        case 'k':
+            checkpoint.every_n_iters = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            checkpoint.interval = std::chrono::seconds(std::strtoul(optarg, nullptr, 10));
+            break;
+        case 'l':
+            lexicon_path = optarg;
+            break;
+        case 'i':
+            init_model_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (model_path.empty() || optind >= argc
+            || (!lexicon_path.empty() && !init_model_path.empty())) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto scheduled = checkpoint.every_n_iters > 0
+        || checkpoint.interval > checkpoint.interval.zero();
+    if (!checkpoint.path.empty() && !scheduled) {
+        std::cerr << argv[0] << ": -c requires -k or -t" << std::endl;
+        return EXIT_FAILURE;
+    } else if (checkpoint.path.empty() && scheduled) {
+        std::cerr << argv[0] << ": -k and -t require -c" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        esapp::segmenter seg(lrv_exp, max_word_length);
+        if (!checkpoint.path.empty() && std::ifstream(checkpoint.path)) {
+            // a previous run has been interrupted; the fitted corpora and
+            // the remaining number of iterations are both in the checkpoint
+            std::cerr << "resume: " << checkpoint.path << std::endl;
+
+            auto start = clock_type::now();
+            seg.resume(checkpoint);
+            std::cerr << "optimize: done in " << seconds_since(start) << " s" << std::endl;
+        } else if (!checkpoint.path.empty()) {
+            fit_corpora(seg, argv + optind, argv + argc);
+            warm_start(seg, lexicon_path, init_model_path);
+
+            auto start = clock_type::now();
+            seg.optimize(n_iters, checkpoint);
+            std::cerr << "optimize: " << n_iters << " iterations in "
+                      << seconds_since(start) << " s" << std::endl;
+        } else {
+            fit_corpora(seg, argv + optind, argv + argc);
+            warm_start(seg, lexicon_path, init_model_path);
+
+            for (decltype(n_iters) i = 0; i < n_iters; i++) {
+                auto start = clock_type::now();
+                seg.optimize(1);
+                std::cerr << "optimize: iteration " << i + 1 << "/" << n_iters << " in "
+                          << seconds_since(start) << " s" << std::endl;
+            }
+        }
+
+        // the vocabulary makes the model usable for warm-starting later runs
+        seg.build_vocabulary();
+
+        std::ofstream os(model_path, std::ios::binary);
+        seg.save(os);
+        if (!os.flush()) {
+            throw std::runtime_error("Failed to write model file: " + model_path);
+        }
+    } catch (std::exception const &e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!checkpoint.path.empty()) {
+        std::remove(checkpoint.path.c_str());
+    }
+
+    return EXIT_SUCCESS;
+}
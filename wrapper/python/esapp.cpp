@@ -1,5 +1,9 @@
+#include <cstdint>
+#include <iterator>
+#include <random>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -30,14 +34,41 @@ PYBIND11_PLUGIN(esapp_python) {
     py::module m("esapp_python");
     py::class_<esapp::segmenter>(m, "Segmenter")
         .def(py::init<double>())
+        .def(py::init<double, std::size_t>())
         .def("fit", [](esapp::segmenter &seg, std::string const &s) {
             seg.fit(s.begin(), s.end());
         })
-        .def("optimize", &esapp::segmenter::optimize)
+        .def("evict", &esapp::segmenter::evict)
+        .def("warm_start", [](esapp::segmenter &seg, std::vector<std::string> const &words) {
+            return seg.warm_start(words.begin(), words.end());
+        })
+        .def("warm_start", [](esapp::segmenter &seg, esapp::segmenter const &model) {
+            return seg.warm_start(model);
+        })
+        .def("num_sequences", &esapp::segmenter::get_num_sequences)
+        .def("optimize", [](esapp::segmenter &seg, std::size_t n_iters) {
+            seg.optimize(n_iters);
+        })
+        .def("optimize", [](esapp::segmenter &seg, std::size_t n_steps,
+                            std::size_t batch_size, std::uint32_t seed) {
+            seg.optimize(n_steps, batch_size, std::mt19937(seed));
+        })
+        .def("set_cache_capacity", &esapp::segmenter::set_cache_capacity,
+             py::arg("capacity"), py::arg("num_shards") = 16)
+        .def("cache_stats", [](esapp::segmenter const &seg) {
+            auto stats = seg.get_cache_stats();
+            return std::make_pair(stats.hits, stats.misses);
+        })
         .def("segment", [](esapp::segmenter const &seg, std::string const &s) {
             py::list list;
             seg.segment(s.begin(), s.end(), py_list_inserter(list));
             return list;
+        })
+        .def("build_vocabulary", &esapp::segmenter::build_vocabulary)
+        .def("segment_ids", [](esapp::segmenter const &seg, std::string const &s) {
+            std::vector<std::size_t> ids;
+            seg.segment_ids(s.begin(), s.end(), std::back_inserter(ids));
+            return ids;
         });
 
     return m.ptr();